@@ -3,53 +3,265 @@
 #include <algorithm>
 #include <chrono>
 #include <future>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cstddef>
+#include <iterator>
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <cmath>
 using namespace std;
 
+/*
+Taking the first element as pivot makes sorted and reversed input
+quadratic, with one recursion level (and one async task) per element.
+The pivot is the median of three samples, or the median of three medians
+(Tukey's ninther) from 128 elements up; the samples cost one walk of the
+list, which the partition pays anyway.
+As in introsort, a chunk that is still being split after
+2*log2(n) levels is handed to std::list::sort, which is O(n log n).
+*/
+inline unsigned introsort_depth_limit(std::size_t size)
+{
+  unsigned depth = 0;
+  for (; size > 1; size >>= 1)
+    ++depth;
+  return 2 * depth;
+}
+
+template <typename Iterator>
+Iterator median_of_three(Iterator a, Iterator b, Iterator c)
+{
+  if (*b < *a) std::swap(a, b);
+  if (*c < *b) std::swap(b, c);
+  if (*b < *a) std::swap(a, b);
+  return b;
+}
+
+template <typename T>
+typename std::list<T>::iterator choose_pivot(std::list<T>& input)
+{
+  std::size_t const size = input.size();
+  if (size < 3)
+  {
+    return input.begin();
+  }
+  std::size_t const samples = size < 128 ? 3 : 9;
+  typename std::list<T>::iterator sample[9];
+  auto it = input.begin();
+  std::size_t pos = 0;
+  for (std::size_t i = 0; i < samples; ++i)
+  {
+    std::size_t const target = i * (size - 1) / (samples - 1);
+    std::advance(it, target - pos);
+    pos = target;
+    sample[i] = it;
+  }
+  if (samples == 3)
+  {
+    return median_of_three(sample[0], sample[1], sample[2]);
+  }
+  return median_of_three(median_of_three(sample[0], sample[1], sample[2]),
+                         median_of_three(sample[3], sample[4], sample[5]),
+                         median_of_three(sample[6], sample[7], sample[8]));
+}
+
+/*
+Lists of up to 16 elements are sorted in place as a leaf, so the
+recursion never pays a splice, a future or an async task for them.
+Arithmetic values are copied into a local array and sorted by a
+Batcher odd-even merge network built at compile time by constexpr
+functions (comparators past n are dropped, as if those positions held
++infinity) and unrolled through an index_sequence; the compare-exchange
+compiles to cmov or minss/maxss rather than a branch. Other types use
+std::list::sort.
+*/
+std::size_t const max_network_size = 16;
+
+struct network_comparator
+{
+  unsigned char i;
+  unsigned char j;
+};
+
+template <typename Emit>
+constexpr void batcher_network(std::size_t n, Emit emit)
+{
+  std::size_t p2 = 1;
+  while (p2 < n)
+    p2 *= 2;
+  for (std::size_t p = 1; p < p2; p *= 2)
+    for (std::size_t k = p; k > 0; k /= 2)
+      for (std::size_t j = k % p; j + k < p2; j += 2 * k)
+        for (std::size_t i = 0; i < k; ++i)
+          if ((i + j) / (2 * p) == (i + j + k) / (2 * p) && i + j + k < n)
+            emit(i + j, i + j + k);
+}
+
+template <std::size_t N>
+constexpr std::size_t network_length()
+{
+  std::size_t length = 0;
+  batcher_network(N, [&](std::size_t, std::size_t){ ++length; });
+  return length;
+}
+
+template <std::size_t N>
+constexpr std::array<network_comparator, network_length<N>()> make_network()
+{
+  std::array<network_comparator, network_length<N>()> network{};
+  std::size_t pos = 0;
+  batcher_network(N, [&](std::size_t i, std::size_t j){
+    network[pos++] = network_comparator{static_cast<unsigned char>(i),
+                                        static_cast<unsigned char>(j)};
+  });
+  return network;
+}
+
+template <std::size_t N>
+inline constexpr auto sorting_network = make_network<N>();
+
+template <typename T>
+void compare_exchange(T& a, T& b)
+{
+  if constexpr (std::is_integral<T>::value)
+  {
+    // hi from the xor keeps gcc from turning the pair into a branch
+    T const lo = b < a ? b : a;
+    T const hi = a ^ b ^ lo;
+    a = lo;
+    b = hi;
+  }
+  else
+  {
+    // both outputs from one comparison: with std::min and std::max
+    // equal values (+0.0 and -0.0) would both come out as a
+    bool const swap = b < a;
+    T const lo = swap ? b : a;
+    T const hi = swap ? a : b;
+    a = lo;
+    b = hi;
+  }
+}
+
+template <std::size_t N, typename T, std::size_t... I>
+void network_sort([[maybe_unused]] T* v, std::index_sequence<I...>)
+{
+  (compare_exchange(v[sorting_network<N>[I].i], v[sorting_network<N>[I].j]),
+   ...);
+}
+
+template <typename T, std::size_t... N>
+void network_sort_dispatch(T* v, std::size_t size, std::index_sequence<N...>)
+{
+  static constexpr void (*table[])(T*) = {
+    [](T* w){ network_sort<N>(w, std::make_index_sequence<
+                                   sorting_network<N>.size()>()); }...
+  };
+  table[size](v);
+}
+
+template <typename T>
+void small_sort_list(std::list<T>& input)
+{
+  if constexpr (std::is_arithmetic<T>::value)
+  {
+    T values[max_network_size];
+    std::size_t const size =
+      std::copy(input.begin(), input.end(), values) - values;
+    network_sort_dispatch(values, size,
+                          std::make_index_sequence<max_network_size + 1>());
+    std::copy(values, values + size, input.begin());
+  }
+  else
+  {
+    input.sort();
+  }
+}
+
 // Function programming quick sort
 template <typename T>
-std::list<T> sequential_quick_sort(std::list<T> input)
+std::list<T> sequential_quick_sort_impl(std::list<T> input,
+                                        unsigned depth_limit)
 {
-  if (input.empty())
+  if (input.size() <= max_network_size)
   {
+    small_sort_list(input);
+    return input;
+  }
+  if (!depth_limit)
+  {
+    input.sort();
     return input;
   }
   std::list<T> result;
-  result.splice(result.begin(), input, input.begin());
+  result.splice(result.begin(), input, choose_pivot(input));
   T const& pivot = *result.begin();
   auto divide_point = std::partition(input.begin(), input.end(),
                     [&](T const& t){return t < pivot;});
   std::list<T> lower_part;
   lower_part.splice(lower_part.end(), input, input.begin(), divide_point);
-  auto new_lower(sequential_quick_sort(std::move(lower_part)));
-  auto new_higher(sequential_quick_sort(std::move(input)));
+  auto new_lower(sequential_quick_sort_impl(std::move(lower_part),
+                                            depth_limit - 1));
+  auto new_higher(sequential_quick_sort_impl(std::move(input),
+                                             depth_limit - 1));
   result.splice(result.end(), new_higher);
   result.splice(result.begin(), new_lower);
   return result;
 }
 
+template <typename T>
+std::list<T> sequential_quick_sort(std::list<T> input)
+{
+  unsigned const depth_limit = introsort_depth_limit(input.size());
+  return sequential_quick_sort_impl(std::move(input), depth_limit);
+}
+
 template<typename T>
-std::list<T> parallel_quick_sort(std::list<T> input)
+std::list<T> parallel_quick_sort_impl(std::list<T> input, unsigned depth_limit)
 {
-  if (input.empty())
+  if (input.size() <= max_network_size)
   {
+    small_sort_list(input);
+    return input;
+  }
+  if (!depth_limit)
+  {
+    input.sort();
     return input;
   }
   std::list<T> result;
-  result.splice(result.begin(), input, input.begin());
+  result.splice(result.begin(), input, choose_pivot(input));
   T const& pivot = *result.begin();
   auto divide_point = std::partition(input.begin(), input.end(),
                     [&](T const& t){return t < pivot;});
   std::list<T> lower_part;
   lower_part.splice(lower_part.end(), input, input.begin(), divide_point);
   std::future<std::list<T>> new_lower{
-    std::async(&parallel_quick_sort<T>, std::move(lower_part))
+    std::async(&parallel_quick_sort_impl<T>, std::move(lower_part),
+               depth_limit - 1)
   };
-  auto new_higher(parallel_quick_sort(std::move(input)));
+  auto new_higher(parallel_quick_sort_impl(std::move(input), depth_limit - 1));
   result.splice(result.end(), new_higher);
   result.splice(result.begin(), new_lower.get());
   return result;
 }
 
+template<typename T>
+std::list<T> parallel_quick_sort(std::list<T> input)
+{
+  unsigned const depth_limit = introsort_depth_limit(input.size());
+  return parallel_quick_sort_impl(std::move(input), depth_limit);
+}
+
 template<typename F, typename A>
 std::future<typename std::result_of<F(A&&)>::type>
 spawn_task(F&& f, A&& a)
@@ -62,6 +274,506 @@ spawn_task(F&& f, A&& a)
   return res;
 }
 
+class join_threads
+{
+    std::vector<std::thread>& threads;
+public:
+    explicit join_threads(std::vector<std::thread>& threads_):
+        threads(threads_)
+    {}
+    ~join_threads()
+    {
+        for(unsigned long i=0;i<threads.size();++i)
+        {
+            if(threads[i].joinable())
+                threads[i].join();
+        }
+    }
+};
+
+class function_wrapper
+{
+    struct impl_base
+    {
+        virtual void call()=0;
+        virtual ~impl_base() {}
+    };
+    std::unique_ptr<impl_base> impl;
+    template<typename F>
+    struct impl_type: impl_base
+    {
+        F f;
+        impl_type(F&& f_): f(std::move(f_)) {}
+        void call() { f(); }
+    };
+public:
+    template<typename F>
+    function_wrapper(F&& f):
+        impl(new impl_type<F>(std::move(f)))
+    {}
+    void operator()() { impl->call(); }
+    function_wrapper()=default;
+    function_wrapper(function_wrapper&& other):
+        impl(std::move(other.impl))
+    {}
+    function_wrapper& operator=(function_wrapper&& other)
+    {
+        impl=std::move(other.impl);
+        return *this;
+    }
+    function_wrapper(const function_wrapper&)=delete;
+    function_wrapper(function_wrapper&)=delete;
+    function_wrapper& operator=(const function_wrapper&)=delete;
+};
+
+/*
+Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli,
+"Correct and Efficient Work-Stealing for Weak Memory Models").
+The owning thread pushes and pops at the bottom without any lock; other
+threads steal from the top and only contend with each other (and with the
+owner on the last element) through a CAS on top.
+Arrays replaced by grow() are kept until destruction because a thief may
+still be reading from them.
+*/
+class work_stealing_queue
+{
+private:
+    typedef function_wrapper* data_type;
+    struct circular_array
+    {
+        long const size;
+        std::unique_ptr<std::atomic<data_type>[]> buffer;
+        explicit circular_array(long size_):
+            size(size_),buffer(new std::atomic<data_type>[size_])
+        {}
+        data_type get(long i) const
+        {
+            return buffer[i&(size-1)].load(std::memory_order_relaxed);
+        }
+        void put(long i,data_type x)
+        {
+            buffer[i&(size-1)].store(x,std::memory_order_relaxed);
+        }
+        circular_array* grow(long bottom,long top) const
+        {
+            circular_array* const a=new circular_array(2*size);
+            for(long i=top;i!=bottom;++i)
+            {
+                a->put(i,get(i));
+            }
+            return a;
+        }
+    };
+    std::atomic<long> top;
+    std::atomic<long> bottom;
+    std::atomic<circular_array*> array;
+    std::vector<std::unique_ptr<circular_array> > old_arrays;
+public:
+    work_stealing_queue():
+        top(0),bottom(0),array(new circular_array(64))
+    {}
+    work_stealing_queue(const work_stealing_queue& other)=delete;
+    work_stealing_queue& operator=(
+        const work_stealing_queue& other)=delete;
+    ~work_stealing_queue()
+    {
+        data_type task;
+        while(try_pop(task))
+        {
+            delete task;
+        }
+        delete array.load();
+    }
+
+    void push(data_type x)
+    {
+        long const b=bottom.load(std::memory_order_relaxed);
+        long const t=top.load(std::memory_order_acquire);
+        circular_array* a=array.load(std::memory_order_relaxed);
+        if(b-t>a->size-1)
+        {
+            old_arrays.emplace_back(a);
+            a=a->grow(b,t);
+            array.store(a,std::memory_order_release);
+        }
+        a->put(b,x);
+        bottom.store(b+1,std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_relaxed)<=
+            top.load(std::memory_order_relaxed);
+    }
+
+    bool try_pop(data_type& res)
+    {
+        long const b=bottom.load(std::memory_order_relaxed)-1;
+        circular_array* const a=array.load(std::memory_order_relaxed);
+        bottom.store(b,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t=top.load(std::memory_order_relaxed);
+        if(t>b)
+        {
+            bottom.store(b+1,std::memory_order_relaxed);
+            return false;
+        }
+        res=a->get(b);
+        if(t==b)
+        {
+            bool const won=top.compare_exchange_strong(
+                t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+            bottom.store(b+1,std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool try_steal(data_type& res)
+    {
+        long t=top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long const b=bottom.load(std::memory_order_acquire);
+        if(t>=b)
+        {
+            return false;
+        }
+        circular_array* const a=array.load(std::memory_order_acquire);
+        res=a->get(t);
+        return top.compare_exchange_strong(
+            t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+    }
+};
+
+/*
+Fixed-size pool: every worker owns a work_stealing_queue, tasks submitted
+from a worker go to its own queue, tasks submitted from outside go to a
+shared queue. An idle worker steals from a randomly chosen victim.
+A task waiting on a future from the pool should call run_pending_task()
+in its wait loop so nested splits never deadlock. Outside callers enter
+through run(), which hands the whole job to a worker: that way every split
+is popped LIFO from a worker's own deque and the helping recursion stays
+as deep as the split tree rather than the number of queued tasks.
+*/
+class thread_pool
+{
+    typedef function_wrapper task_type;
+
+    std::atomic_bool done;
+    std::mutex pool_work_mutex;
+    std::deque<task_type*> pool_work_queue;
+    std::vector<std::unique_ptr<work_stealing_queue> > queues;
+    std::vector<std::thread> threads;
+    join_threads joiner;
+
+    static thread_local thread_pool* local_pool;
+    static thread_local work_stealing_queue* local_work_queue;
+    static thread_local unsigned my_index;
+
+    void worker_thread(unsigned my_index_)
+    {
+        my_index=my_index_;
+        local_work_queue=queues[my_index].get();
+        local_pool=this;
+        while(!done)
+        {
+            run_pending_task();
+        }
+    }
+
+    bool pop_task_from_local_queue(task_type*& task)
+    {
+        return local_pool==this && local_work_queue->try_pop(task);
+    }
+
+    bool pop_task_from_pool_queue(task_type*& task)
+    {
+        std::lock_guard<std::mutex> lk(pool_work_mutex);
+        if(pool_work_queue.empty())
+            return false;
+        task=pool_work_queue.front();
+        pool_work_queue.pop_front();
+        return true;
+    }
+
+    bool pop_task_from_other_thread_queue(task_type*& task)
+    {
+        if(queues.empty())
+            return false;
+        thread_local std::minstd_rand rng(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+        unsigned const victim=rng()%queues.size();
+        for(unsigned i=0;i<queues.size();++i)
+        {
+            unsigned const index=(victim+i)%queues.size();
+            if(local_pool==this && index==my_index)
+                continue;
+            if(queues[index]->try_steal(task))
+                return true;
+        }
+        return false;
+    }
+
+public:
+    explicit thread_pool(
+        unsigned const thread_count=std::thread::hardware_concurrency()):
+        done(false),joiner(threads)
+    {
+        if(!thread_count)
+        {
+            throw std::invalid_argument("thread_pool needs at least one thread");
+        }
+        try
+        {
+            for(unsigned i=0;i<thread_count;++i)
+            {
+                queues.push_back(std::unique_ptr<work_stealing_queue>(
+                                     new work_stealing_queue));
+            }
+            for(unsigned i=0;i<thread_count;++i)
+            {
+                threads.push_back(
+                    std::thread(&thread_pool::worker_thread,this,i));
+            }
+        }
+        catch(...)
+        {
+            done=true;
+            throw;
+        }
+    }
+
+    ~thread_pool()
+    {
+        done=true;
+        for(unsigned i=0;i<threads.size();++i)
+        {
+            if(threads[i].joinable())
+                threads[i].join();
+        }
+        for(task_type* task: pool_work_queue)
+        {
+            delete task;
+        }
+    }
+
+    template<typename FunctionType>
+    std::future<typename std::result_of<FunctionType()>::type>
+    submit(FunctionType f)
+    {
+        typedef typename std::result_of<FunctionType()>::type result_type;
+        std::packaged_task<result_type()> task(std::move(f));
+        std::future<result_type> res(task.get_future());
+        task_type* const wrapped=new task_type(std::move(task));
+        if(local_pool==this)
+        {
+            local_work_queue->push(wrapped);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lk(pool_work_mutex);
+            pool_work_queue.push_back(wrapped);
+        }
+        return res;
+    }
+
+    template<typename FunctionType>
+    typename std::result_of<FunctionType()>::type run(FunctionType f)
+    {
+        if(local_pool==this)
+        {
+            return f();
+        }
+        return submit(std::move(f)).get();
+    }
+
+    void run_pending_task()
+    {
+        task_type* task;
+        if(pop_task_from_local_queue(task) ||
+           pop_task_from_pool_queue(task) ||
+           pop_task_from_other_thread_queue(task))
+        {
+            std::unique_ptr<task_type> owned(task);
+            (*owned)();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+thread_local thread_pool* thread_pool::local_pool=nullptr;
+thread_local work_stealing_queue* thread_pool::local_work_queue=nullptr;
+thread_local unsigned thread_pool::my_index=0;
+
+template<typename T>
+std::list<T> parallel_quick_sort_pooled_impl(thread_pool& pool,
+                                             std::list<T> input,
+                                             unsigned depth_limit)
+{
+  if (input.size() <= max_network_size)
+  {
+    small_sort_list(input);
+    return input;
+  }
+  if (!depth_limit)
+  {
+    input.sort();
+    return input;
+  }
+  std::list<T> result;
+  result.splice(result.begin(), input, choose_pivot(input));
+  T const& pivot = *result.begin();
+  auto divide_point = std::partition(input.begin(), input.end(),
+                    [&](T const& t){return t < pivot;});
+  std::list<T> lower_part;
+  lower_part.splice(lower_part.end(), input, input.begin(), divide_point);
+  std::future<std::list<T>> new_lower{
+    pool.submit([&pool, lower = std::move(lower_part), depth_limit]() mutable {
+      return parallel_quick_sort_pooled_impl(pool, std::move(lower),
+                                             depth_limit - 1);
+    })
+  };
+  auto new_higher(parallel_quick_sort_pooled_impl(pool, std::move(input),
+                                                  depth_limit - 1));
+  result.splice(result.end(), new_higher);
+  while (new_lower.wait_for(std::chrono::seconds(0)) !=
+         std::future_status::ready)
+  {
+    pool.run_pending_task();
+  }
+  result.splice(result.begin(), new_lower.get());
+  return result;
+}
+
+template<typename T>
+std::list<T> parallel_quick_sort_pooled(thread_pool& pool, std::list<T> input)
+{
+  unsigned const depth_limit = introsort_depth_limit(input.size());
+  return pool.run([&pool, &input, depth_limit]{
+    return parallel_quick_sort_pooled_impl(pool, std::move(input),
+                                           depth_limit);
+  });
+}
+
+void benchmark_sort()
+{
+  // every split of the std::async version is a new thread, so keep it small
+  unsigned const size = 20000;
+  std::list<int> input;
+  std::mt19937 gen(42);
+  for (unsigned i = 0; i < size; ++i)
+    input.push_back(static_cast<int>(gen()));
+
+  auto start=std::chrono::high_resolution_clock::now();
+  auto expected = parallel_quick_sort(input);
+  auto stop=std::chrono::high_resolution_clock::now();
+  double const async_seconds =
+    std::chrono::duration<double, std::ratio<1,1>>(stop-start).count();
+  std::cout<<"std::async sort: "<<size/async_seconds/1e6
+  <<" Melem/s"<<std::endl;
+
+  unsigned const hardware_threads =
+    std::max(std::thread::hardware_concurrency(), 1u);
+  for (unsigned cores = 1; cores <= hardware_threads; ++cores)
+  {
+    thread_pool pool(cores);
+    start=std::chrono::high_resolution_clock::now();
+    auto result = parallel_quick_sort_pooled(pool, input);
+    stop=std::chrono::high_resolution_clock::now();
+    double const pool_seconds =
+      std::chrono::duration<double, std::ratio<1,1>>(stop-start).count();
+    std::cout<<"pool sort, "<<cores<<" cores: "<<size/pool_seconds/1e6
+    <<" Melem/s"<<(result == expected ? "" : " (WRONG RESULT)")<<std::endl;
+  }
+}
+
+std::list<int> adversarial_input(std::string const& pattern, unsigned size)
+{
+  std::list<int> input;
+  for (unsigned i = 0; i < size; ++i)
+  {
+    if (pattern == "sorted")
+      input.push_back(static_cast<int>(i));
+    else if (pattern == "reversed")
+      input.push_back(static_cast<int>(size - i));
+    else if (pattern == "organ-pipe")
+      input.push_back(static_cast<int>(i < size / 2 ? i : size - i));
+    else
+      input.push_back(static_cast<int>(i % 4));
+  }
+  return input;
+}
+
+void benchmark_adversarial_sort()
+{
+  unsigned const size = 10000;
+  thread_pool pool(std::max(std::thread::hardware_concurrency(), 1u));
+  for (std::string const pattern :
+         {"sorted", "reversed", "organ-pipe", "few-distinct"})
+  {
+    std::list<int> const input = adversarial_input(pattern, size);
+    std::cout << pattern << ":";
+
+    auto start=std::chrono::high_resolution_clock::now();
+    auto result = sequential_quick_sort(input);
+    auto stop=std::chrono::high_resolution_clock::now();
+    std::cout << " sequential "
+    << std::chrono::duration<double, std::ratio<1,1>>(stop-start).count()
+    << " s";
+
+    start=std::chrono::high_resolution_clock::now();
+    result = parallel_quick_sort(input);
+    stop=std::chrono::high_resolution_clock::now();
+    std::cout << ", std::async "
+    << std::chrono::duration<double, std::ratio<1,1>>(stop-start).count()
+    << " s";
+
+    start=std::chrono::high_resolution_clock::now();
+    result = parallel_quick_sort_pooled(pool, input);
+    stop=std::chrono::high_resolution_clock::now();
+    std::cout << ", pool "
+    << std::chrono::duration<double, std::ratio<1,1>>(stop-start).count()
+    << " s"
+    << (std::is_sorted(result.begin(), result.end()) ? "" : " (NOT SORTED)")
+    << std::endl;
+  }
+}
+
+// -0.0 and +0.0 compare equal but are different values, so a sort must
+// hand back as many of each as it was given
+void check_signed_zeros()
+{
+  std::list<double> input;
+  for (unsigned i = 0; i < 64; ++i)
+    input.push_back(i % 3 == 0 ? -0.0 : i % 3 == 1 ? 0.0 : double(i % 4));
+  auto const same_values = [](std::list<double> const& sorted,
+                              std::list<double> const& original)
+  {
+    return std::is_sorted(sorted.begin(), sorted.end()) &&
+      std::is_permutation(sorted.begin(), sorted.end(),
+                          original.begin(), original.end(),
+                          [](double x, double y)
+                          {
+                            return x == y &&
+                              std::signbit(x) == std::signbit(y);
+                          });
+  };
+  bool ok = true;
+  for (std::size_t n = 2; n <= max_network_size; ++n)
+  {
+    std::list<double> leaf(input.begin(), std::next(input.begin(), n));
+    ok = ok && same_values(sequential_quick_sort(leaf), leaf);
+  }
+  thread_pool pool(2);
+  ok = ok && same_values(sequential_quick_sort(input), input)
+    && same_values(parallel_quick_sort(input), input)
+    && same_values(parallel_quick_sort_pooled(pool, input), input);
+  std::cout << "signed zeros and duplicates "
+  << (ok ? "preserved" : "NOT PRESERVED") << std::endl;
+}
+
 void fp_sort()
 {
   std::list<int> ab{10,9,8,7,6,5,4,3,2,1};
@@ -80,5 +792,8 @@ void fp_sort()
 int main()
 {
   fp_sort();
+  check_signed_zeros();
+  benchmark_sort();
+  benchmark_adversarial_sort();
   return 0;
 }
@@ -7,6 +7,16 @@
 #include <algorithm>
 #include <shared_mutex>
 #include <vector>
+#include <queue>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 using namespace std;
 
 //Enabling concurrency by separating data
@@ -34,7 +44,7 @@ private:
 
     std::unique_ptr<node> pop_head()
     {
-      std::unique_ptr<node> const old_head=std::move(head);
+      std::unique_ptr<node> old_head=std::move(head);
       head=std::move(old_head->next);
       return old_head;
     }
@@ -42,8 +52,8 @@ private:
     std::unique_lock<std::mutex> wait_for_data()
     {
         std::unique_lock<std::mutex> head_lock(head_mutex);
-        data_cond.wait(head_lock,[&]{return head!= get_tail();});
-        return std::move(head_lock);
+        data_cond.wait(head_lock,[&]{return head.get()!=get_tail();});
+        return head_lock;
     }
 
     std::unique_ptr<node> wait_pop_head()
@@ -125,7 +135,215 @@ public:
     bool empty()
     {
         std::lock_guard<std::mutex> head_lock(head_mutex);
-        return (head==get_tail());
+        return (head.get()==get_tail());
+    }
+};
+
+/*
+A bounded multi-producer multi-consumer queue (Dmitry Vyukov's ring
+buffer). Both queues above allocate on every push; this one allocates
+its slots once, in the constructor.
+Every slot carries a sequence number. Slot pos&mask is free for the
+producer holding ticket pos when its sequence equals pos, and full for
+the consumer holding ticket pos when it equals pos+1. Popping sets it to
+pos+capacity, which frees it for the next lap. A producer claims a
+ticket by a CAS on enqueue_pos, builds the value in place, then
+publishes it with a release store of the sequence. Consumers do the
+same with dequeue_pos. The two indices live on separate cache lines so
+that producers and consumers do not invalidate each other's line on
+every operation.
+The capacity is rounded up to a power of two (at least 2) so that the
+slot index is a mask. try_push and try_pop never block; push waits
+while the queue is full and wait_and_pop while it is empty. They spin
+briefly, then sleep on a condition variable. The mutex is only taken
+when somebody is asleep, so the common path takes no lock. There are no
+shared_ptr overloads, since those would allocate. T's constructors and
+move assignment should not throw: a throw after a ticket is claimed
+leaves that slot claimed for good.
+*/
+std::size_t const cache_line_size=64;
+
+template<typename T>
+class bounded_mpmc_queue
+{
+private:
+    struct slot
+    {
+        std::atomic<std::size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value()
+        {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    static unsigned const spin_count=64;
+
+    alignas(cache_line_size) std::size_t const mask;
+    std::unique_ptr<slot[]> const slots;
+    alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos;
+    alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos;
+    alignas(cache_line_size) std::atomic<unsigned> pop_waiters;
+    std::atomic<unsigned> push_waiters;
+    std::mutex wait_mutex;
+    std::condition_variable data_cond;
+    std::condition_variable space_cond;
+
+    static std::size_t round_capacity(std::size_t capacity)
+    {
+        if(capacity>(std::size_t(1)<<(sizeof(std::size_t)*8-2)))
+            throw std::length_error("bounded_mpmc_queue capacity too large");
+        std::size_t rounded=2;
+        while(rounded<capacity)
+            rounded*=2;
+        return rounded;
+    }
+
+    // wake sleepers of the other side, if there are any
+    void wake(std::atomic<unsigned>& waiters,std::condition_variable& cond)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(waiters.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lk(wait_mutex);
+            cond.notify_one();
+        }
+    }
+
+    template<typename Try>
+    void wait_for(std::atomic<unsigned>& waiters,std::condition_variable& cond,
+                  Try attempt)
+    {
+        for(unsigned spin=0;spin<spin_count;++spin)
+        {
+            if(attempt())
+                return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lk(wait_mutex);
+        waiters.fetch_add(1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lk,attempt);
+        waiters.fetch_sub(1,std::memory_order_relaxed);
+    }
+
+    template<typename U>
+    bool push_slot(U&& new_value)
+    {
+        std::size_t pos=enqueue_pos.load(std::memory_order_relaxed);
+        slot* target;
+        for(;;)
+        {
+            target=&slots[pos&mask];
+            std::size_t const seq=
+                target->sequence.load(std::memory_order_acquire);
+            std::intptr_t const diff=
+                static_cast<std::intptr_t>(seq)-static_cast<std::intptr_t>(pos);
+            if(!diff)
+            {
+                if(enqueue_pos.compare_exchange_weak(
+                       pos,pos+1,std::memory_order_relaxed))
+                    break;
+            }
+            else if(diff<0)
+                return false;
+            else
+                pos=enqueue_pos.load(std::memory_order_relaxed);
+        }
+        new(target->storage) T(std::forward<U>(new_value));
+        target->sequence.store(pos+1,std::memory_order_release);
+        return true;
+    }
+
+    bool pop_slot(T& value)
+    {
+        std::size_t pos=dequeue_pos.load(std::memory_order_relaxed);
+        slot* source;
+        for(;;)
+        {
+            source=&slots[pos&mask];
+            std::size_t const seq=
+                source->sequence.load(std::memory_order_acquire);
+            std::intptr_t const diff=static_cast<std::intptr_t>(seq)-
+                static_cast<std::intptr_t>(pos+1);
+            if(!diff)
+            {
+                if(dequeue_pos.compare_exchange_weak(
+                       pos,pos+1,std::memory_order_relaxed))
+                    break;
+            }
+            else if(diff<0)
+                return false;
+            else
+                pos=dequeue_pos.load(std::memory_order_relaxed);
+        }
+        value=std::move(*source->value());
+        source->value()->~T();
+        source->sequence.store(pos+mask+1,std::memory_order_release);
+        return true;
+    }
+
+public:
+    explicit bounded_mpmc_queue(std::size_t capacity):
+        mask(round_capacity(capacity)-1),slots(new slot[mask+1]),
+        enqueue_pos(0),dequeue_pos(0),pop_waiters(0),push_waiters(0)
+    {
+        for(std::size_t i=0;i<=mask;++i)
+            slots[i].sequence.store(i,std::memory_order_relaxed);
+    }
+
+    bounded_mpmc_queue(const bounded_mpmc_queue& other)=delete;
+    bounded_mpmc_queue& operator=(const bounded_mpmc_queue& other)=delete;
+
+    ~bounded_mpmc_queue()
+    {
+        std::size_t const end=enqueue_pos.load(std::memory_order_relaxed);
+        for(std::size_t pos=dequeue_pos.load(std::memory_order_relaxed);
+            pos!=end;++pos)
+            slots[pos&mask].value()->~T();
+    }
+
+    std::size_t capacity() const
+    {
+        return mask+1;
+    }
+
+    template<typename U>
+    bool try_push(U&& new_value)
+    {
+        if(!push_slot(std::forward<U>(new_value)))
+            return false;
+        wake(pop_waiters,data_cond);
+        return true;
+    }
+
+    void push(T new_value)
+    {
+        wait_for(push_waiters,space_cond,
+                 [&]{return push_slot(std::move(new_value));});
+        wake(pop_waiters,data_cond);
+    }
+
+    bool try_pop(T& value)
+    {
+        if(!pop_slot(value))
+            return false;
+        wake(push_waiters,space_cond);
+        return true;
+    }
+
+    void wait_and_pop(T& value)
+    {
+        wait_for(pop_waiters,data_cond,[&]{return pop_slot(value);});
+        wake(push_waiters,space_cond);
+    }
+
+    // only a snapshot while other threads are pushing or popping
+    bool empty() const
+    {
+        return dequeue_pos.load(std::memory_order_acquire)==
+            enqueue_pos.load(std::memory_order_acquire);
     }
 };
 
@@ -345,8 +563,87 @@ public:
     }
 };
 
+// the single-mutex std::queue wrapper from operation_sharing.cpp, for
+// the benchmark below
+template<typename T>
+class single_lock_queue
+{
+  std::mutex mut;
+  std::queue<T> data_queue;
+  std::condition_variable data_cond;
+public:
+  void push(T new_value)
+  {
+    std::lock_guard<std::mutex> lk(mut);
+    data_queue.push(std::move(new_value));
+    data_cond.notify_one();
+  }
+  void wait_and_pop(T& value)
+  {
+    std::unique_lock<std::mutex> lk(mut);
+    data_cond.wait(lk, [this](){return !data_queue.empty();});
+    value = std::move(data_queue.front());
+    data_queue.pop();
+  }
+};
+
+// each producer pushes its share of items, each consumer pops its share
+template<typename Queue>
+double queue_mops(Queue& q,unsigned producers,unsigned consumers,
+                  unsigned long items)
+{
+  std::atomic<unsigned long long> total(0);
+  std::vector<std::thread> threads;
+  auto const start=std::chrono::high_resolution_clock::now();
+  for(unsigned p=0;p<producers;++p)
+    threads.emplace_back([&q,items,producers]
+    {
+      for(unsigned long i=0;i<items/producers;++i)
+        q.push(i);
+    });
+  for(unsigned c=0;c<consumers;++c)
+    threads.emplace_back([&q,&total,items,consumers]
+    {
+      unsigned long long sum=0;
+      unsigned long value;
+      for(unsigned long i=0;i<items/consumers;++i)
+      {
+        q.wait_and_pop(value);
+        sum+=value;
+      }
+      total+=sum;
+    });
+  for(auto& t:threads)
+    t.join();
+  auto const stop=std::chrono::high_resolution_clock::now();
+  unsigned long const share=items/producers;
+  if(total!=(unsigned long long)producers*share*(share-1)/2)
+    throw std::runtime_error("queue lost or duplicated items");
+  return items/std::chrono::duration<double,std::micro>(stop-start).count();
+}
+
+void benchmark_queues()
+{
+  unsigned long const items=1ul<<20;
+  unsigned const counts[]={1,2,4};
+  cout<<"Mops/s (producers x consumers): single lock, two lock, "
+      <<"bounded mpmc(1024)"<<endl;
+  for(unsigned producers:counts)
+    for(unsigned consumers:counts)
+    {
+      single_lock_queue<unsigned long> single;
+      threadsafe_queue<unsigned long> two_lock;
+      bounded_mpmc_queue<unsigned long> ring(1024);
+      cout<<producers<<"x"<<consumers<<": "
+          <<queue_mops(single,producers,consumers,items)<<", "
+          <<queue_mops(two_lock,producers,consumers,items)<<", "
+          <<queue_mops(ring,producers,consumers,items)<<endl;
+    }
+}
+
 int main()
 {
   threadsafe_queue<int> q;
+  benchmark_queues();
   return 0;
 }
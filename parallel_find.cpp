@@ -8,6 +8,36 @@
 #include <iostream>
 #include <new>
 #include <numeric>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <exception>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <condition_variable>
+#include <limits>
+#include <utility>
+#include <cerrno>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 class join_threads
 {
@@ -26,132 +56,2376 @@ public:
     }
 };
 
+class function_wrapper
+{
+    struct impl_base
+    {
+        virtual void call()=0;
+        virtual ~impl_base() {}
+    };
+    std::unique_ptr<impl_base> impl;
+    template<typename F>
+    struct impl_type: impl_base
+    {
+        F f;
+        impl_type(F&& f_): f(std::move(f_)) {}
+        void call() { f(); }
+    };
+public:
+    template<typename F>
+    function_wrapper(F&& f):
+        impl(new impl_type<F>(std::move(f)))
+    {}
+    void operator()() { impl->call(); }
+    function_wrapper()=default;
+    function_wrapper(function_wrapper&& other):
+        impl(std::move(other.impl))
+    {}
+    function_wrapper& operator=(function_wrapper&& other)
+    {
+        impl=std::move(other.impl);
+        return *this;
+    }
+    function_wrapper(const function_wrapper&)=delete;
+    function_wrapper(function_wrapper&)=delete;
+    function_wrapper& operator=(const function_wrapper&)=delete;
+};
+
+/*
+Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli,
+"Correct and Efficient Work-Stealing for Weak Memory Models").
+The owning thread pushes and pops at the bottom without any lock; other
+threads steal from the top and only contend with each other (and with the
+owner on the last element) through a CAS on top.
+Arrays replaced by grow() are kept until destruction because a thief may
+still be reading from them.
+*/
+class work_stealing_queue
+{
+private:
+    typedef function_wrapper* data_type;
+    struct circular_array
+    {
+        long const size;
+        std::unique_ptr<std::atomic<data_type>[]> buffer;
+        explicit circular_array(long size_):
+            size(size_),buffer(new std::atomic<data_type>[size_])
+        {}
+        data_type get(long i) const
+        {
+            return buffer[i&(size-1)].load(std::memory_order_relaxed);
+        }
+        void put(long i,data_type x)
+        {
+            buffer[i&(size-1)].store(x,std::memory_order_relaxed);
+        }
+        circular_array* grow(long bottom,long top) const
+        {
+            circular_array* const a=new circular_array(2*size);
+            for(long i=top;i!=bottom;++i)
+            {
+                a->put(i,get(i));
+            }
+            return a;
+        }
+    };
+    std::atomic<long> top;
+    std::atomic<long> bottom;
+    std::atomic<circular_array*> array;
+    std::vector<std::unique_ptr<circular_array> > old_arrays;
+public:
+    work_stealing_queue():
+        top(0),bottom(0),array(new circular_array(64))
+    {}
+    work_stealing_queue(const work_stealing_queue& other)=delete;
+    work_stealing_queue& operator=(
+        const work_stealing_queue& other)=delete;
+    ~work_stealing_queue()
+    {
+        data_type task;
+        while(try_pop(task))
+        {
+            delete task;
+        }
+        delete array.load();
+    }
+
+    void push(data_type x)
+    {
+        long const b=bottom.load(std::memory_order_relaxed);
+        long const t=top.load(std::memory_order_acquire);
+        circular_array* a=array.load(std::memory_order_relaxed);
+        if(b-t>a->size-1)
+        {
+            old_arrays.emplace_back(a);
+            a=a->grow(b,t);
+            array.store(a,std::memory_order_release);
+        }
+        a->put(b,x);
+        bottom.store(b+1,std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_relaxed)<=
+            top.load(std::memory_order_relaxed);
+    }
+
+    bool try_pop(data_type& res)
+    {
+        long const b=bottom.load(std::memory_order_relaxed)-1;
+        circular_array* const a=array.load(std::memory_order_relaxed);
+        bottom.store(b,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t=top.load(std::memory_order_relaxed);
+        if(t>b)
+        {
+            bottom.store(b+1,std::memory_order_relaxed);
+            return false;
+        }
+        res=a->get(b);
+        if(t==b)
+        {
+            bool const won=top.compare_exchange_strong(
+                t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+            bottom.store(b+1,std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool try_steal(data_type& res)
+    {
+        long t=top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long const b=bottom.load(std::memory_order_acquire);
+        if(t>=b)
+        {
+            return false;
+        }
+        circular_array* const a=array.load(std::memory_order_acquire);
+        res=a->get(t);
+        return top.compare_exchange_strong(
+            t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+    }
+};
+
+/*
+Fixed-size pool: every worker owns a work_stealing_queue, tasks submitted
+from a worker go to its own queue, tasks submitted from outside go to a
+shared queue. An idle worker steals from a randomly chosen victim.
+A task waiting on a future from the pool should call run_pending_task()
+in its wait loop so nested splits never deadlock. Outside callers enter
+through run(), which hands the whole job to a worker: that way every split
+is popped LIFO from a worker's own deque and the helping recursion stays
+as deep as the split tree rather than the number of queued tasks.
+*/
+class thread_pool
+{
+    typedef function_wrapper task_type;
+
+    std::atomic_bool done;
+    std::mutex pool_work_mutex;
+    std::deque<task_type*> pool_work_queue;
+    std::vector<std::unique_ptr<work_stealing_queue> > queues;
+    std::vector<std::thread> threads;
+    join_threads joiner;
+
+    static thread_local thread_pool* local_pool;
+    static thread_local work_stealing_queue* local_work_queue;
+    static thread_local unsigned my_index;
+
+    void worker_thread(unsigned my_index_)
+    {
+        my_index=my_index_;
+        local_work_queue=queues[my_index].get();
+        local_pool=this;
+        while(!done)
+        {
+            run_pending_task();
+        }
+    }
+
+    bool pop_task_from_local_queue(task_type*& task)
+    {
+        return local_pool==this && local_work_queue->try_pop(task);
+    }
+
+    bool pop_task_from_pool_queue(task_type*& task)
+    {
+        std::lock_guard<std::mutex> lk(pool_work_mutex);
+        if(pool_work_queue.empty())
+            return false;
+        task=pool_work_queue.front();
+        pool_work_queue.pop_front();
+        return true;
+    }
+
+    bool pop_task_from_other_thread_queue(task_type*& task)
+    {
+        if(queues.empty())
+            return false;
+        thread_local std::minstd_rand rng(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+        unsigned const victim=rng()%queues.size();
+        for(unsigned i=0;i<queues.size();++i)
+        {
+            unsigned const index=(victim+i)%queues.size();
+            if(local_pool==this && index==my_index)
+                continue;
+            if(queues[index]->try_steal(task))
+                return true;
+        }
+        return false;
+    }
+
+public:
+    explicit thread_pool(
+        unsigned const thread_count=std::thread::hardware_concurrency()):
+        done(false),joiner(threads)
+    {
+        if(!thread_count)
+        {
+            throw std::invalid_argument("thread_pool needs at least one thread");
+        }
+        try
+        {
+            for(unsigned i=0;i<thread_count;++i)
+            {
+                queues.push_back(std::unique_ptr<work_stealing_queue>(
+                                     new work_stealing_queue));
+            }
+            for(unsigned i=0;i<thread_count;++i)
+            {
+                threads.push_back(
+                    std::thread(&thread_pool::worker_thread,this,i));
+            }
+        }
+        catch(...)
+        {
+            done=true;
+            throw;
+        }
+    }
+
+    ~thread_pool()
+    {
+        done=true;
+        for(unsigned i=0;i<threads.size();++i)
+        {
+            if(threads[i].joinable())
+                threads[i].join();
+        }
+        for(task_type* task: pool_work_queue)
+        {
+            delete task;
+        }
+    }
+
+    template<typename FunctionType>
+    std::future<typename std::result_of<FunctionType()>::type>
+    submit(FunctionType f)
+    {
+        typedef typename std::result_of<FunctionType()>::type result_type;
+        std::packaged_task<result_type()> task(std::move(f));
+        std::future<result_type> res(task.get_future());
+        task_type* const wrapped=new task_type(std::move(task));
+        if(local_pool==this)
+        {
+            local_work_queue->push(wrapped);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lk(pool_work_mutex);
+            pool_work_queue.push_back(wrapped);
+        }
+        return res;
+    }
+
+    template<typename FunctionType>
+    typename std::result_of<FunctionType()>::type run(FunctionType f)
+    {
+        if(local_pool==this)
+        {
+            return f();
+        }
+        return submit(std::move(f)).get();
+    }
+
+    void run_pending_task()
+    {
+        task_type* task;
+        if(pop_task_from_local_queue(task) ||
+           pop_task_from_pool_queue(task) ||
+           pop_task_from_other_thread_queue(task))
+        {
+            std::unique_ptr<task_type> owned(task);
+            (*owned)();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+thread_local thread_pool* thread_pool::local_pool=nullptr;
+thread_local work_stealing_queue* thread_pool::local_work_queue=nullptr;
+thread_local unsigned thread_pool::my_index=0;
+
+/*
+Vectorised leaf for contiguous ranges of char, 32-bit integer or float
+values searched for a value of the same type. The kernel compares a whole
+register of lanes at once (64 bytes per iteration with SSE2, 128 with
+AVX2), ORs the compare masks and only looks for the lane once a movemask
+is non-zero. AVX2 is picked at run time with __builtin_cpu_supports, so
+the binary still runs on any x86-64; other targets use std::find.
+Floats are compared with cmpeq_ps, not bitwise, so NaN and -0.0 behave
+as with operator==.
+The scan is cut into find_block_bytes blocks and the done flag is read
+once per block instead of once per element, and the recursion stops
+splitting at simd_leaf_bytes rather than 25 elements.
+*/
+std::size_t const find_block_bytes=4096;
+std::size_t const simd_leaf_bytes=1<<16;
+
+template<typename T>
+struct simd_findable:
+    std::integral_constant<bool,
+        (std::is_integral<T>::value && !std::is_same<T,bool>::value &&
+         (sizeof(T)==1 || sizeof(T)==4)) ||
+        std::is_same<T,float>::value>
+{};
+
+// pointers and vector/string iterators whose *it is a real element;
+// std::vector<bool> hands out proxies and stays scalar, like anything else
+template<typename Iterator,typename MatchType>
+struct use_simd_find
+{
+    typedef typename std::iterator_traits<Iterator>::value_type value_type;
+    typedef decltype(*std::declval<Iterator&>()) reference;
+    static constexpr bool contiguous=
+        std::is_lvalue_reference<reference>::value &&
+        std::is_same<typename std::remove_cv<
+                         typename std::remove_reference<reference>::type>::type,
+                     value_type>::value &&
+        (std::is_pointer<Iterator>::value ||
+         std::is_same<Iterator,
+             typename std::vector<value_type>::iterator>::value ||
+         std::is_same<Iterator,
+             typename std::vector<value_type>::const_iterator>::value ||
+         std::is_same<Iterator,
+             typename std::basic_string<value_type>::iterator>::value ||
+         std::is_same<Iterator,
+             typename std::basic_string<value_type>::const_iterator>::value);
+    static constexpr bool value=contiguous &&
+        simd_findable<value_type>::value &&
+        std::is_same<typename std::decay<MatchType>::type,value_type>::value;
+};
+
+#if defined(__x86_64__)
+template<typename T>
+__attribute__((target("sse2")))
+inline __m128i compare_lanes(__m128i a,__m128i b)
+{
+    if constexpr(std::is_same<T,float>::value)
+        return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a),
+                                             _mm_castsi128_ps(b)));
+    else if constexpr(sizeof(T)==1)
+        return _mm_cmpeq_epi8(a,b);
+    else
+        return _mm_cmpeq_epi32(a,b);
+}
+
+template<typename T>
+__attribute__((target("sse2")))
+T const* find_sse2(T const* first,T const* last,T value)
+{
+    std::size_t const lanes=16/sizeof(T);
+    __m128i needle;
+    if constexpr(std::is_same<T,float>::value)
+        needle=_mm_castps_si128(_mm_set1_ps(value));
+    else if constexpr(sizeof(T)==1)
+        needle=_mm_set1_epi8(static_cast<char>(value));
+    else
+        needle=_mm_set1_epi32(static_cast<int>(value));
+    while(static_cast<std::size_t>(last-first)>=4*lanes)
+    {
+        __m128i const* const p=reinterpret_cast<__m128i const*>(first);
+        __m128i const m0=compare_lanes<T>(_mm_loadu_si128(p),needle);
+        __m128i const m1=compare_lanes<T>(_mm_loadu_si128(p+1),needle);
+        __m128i const m2=compare_lanes<T>(_mm_loadu_si128(p+2),needle);
+        __m128i const m3=compare_lanes<T>(_mm_loadu_si128(p+3),needle);
+        __m128i const any=_mm_or_si128(_mm_or_si128(m0,m1),
+                                       _mm_or_si128(m2,m3));
+        if(_mm_movemask_epi8(any))
+        {
+            std::uint64_t const mask=
+                static_cast<std::uint64_t>(_mm_movemask_epi8(m0)) |
+                static_cast<std::uint64_t>(_mm_movemask_epi8(m1))<<16 |
+                static_cast<std::uint64_t>(_mm_movemask_epi8(m2))<<32 |
+                static_cast<std::uint64_t>(_mm_movemask_epi8(m3))<<48;
+            return first+__builtin_ctzll(mask)/sizeof(T);
+        }
+        first+=4*lanes;
+    }
+    return std::find(first,last,value);
+}
+
+template<typename T>
+__attribute__((target("avx2")))
+inline __m256i compare_lanes_avx2(__m256i a,__m256i b)
+{
+    if constexpr(std::is_same<T,float>::value)
+        return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a),
+                                                 _mm256_castsi256_ps(b),
+                                                 _CMP_EQ_OQ));
+    else if constexpr(sizeof(T)==1)
+        return _mm256_cmpeq_epi8(a,b);
+    else
+        return _mm256_cmpeq_epi32(a,b);
+}
+
+template<typename T>
+__attribute__((target("avx2")))
+T const* find_avx2(T const* first,T const* last,T value)
+{
+    std::size_t const lanes=32/sizeof(T);
+    __m256i needle;
+    if constexpr(std::is_same<T,float>::value)
+        needle=_mm256_castps_si256(_mm256_set1_ps(value));
+    else if constexpr(sizeof(T)==1)
+        needle=_mm256_set1_epi8(static_cast<char>(value));
+    else
+        needle=_mm256_set1_epi32(static_cast<int>(value));
+    while(static_cast<std::size_t>(last-first)>=4*lanes)
+    {
+        __m256i const* const p=reinterpret_cast<__m256i const*>(first);
+        __m256i const m0=compare_lanes_avx2<T>(_mm256_loadu_si256(p),needle);
+        __m256i const m1=compare_lanes_avx2<T>(_mm256_loadu_si256(p+1),needle);
+        __m256i const m2=compare_lanes_avx2<T>(_mm256_loadu_si256(p+2),needle);
+        __m256i const m3=compare_lanes_avx2<T>(_mm256_loadu_si256(p+3),needle);
+        __m256i const any=_mm256_or_si256(_mm256_or_si256(m0,m1),
+                                          _mm256_or_si256(m2,m3));
+        if(_mm256_movemask_epi8(any))
+        {
+            std::uint64_t const low=
+                static_cast<std::uint32_t>(_mm256_movemask_epi8(m0)) |
+                static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                    _mm256_movemask_epi8(m1)))<<32;
+            if(low)
+                return first+__builtin_ctzll(low)/sizeof(T);
+            std::uint64_t const high=
+                static_cast<std::uint32_t>(_mm256_movemask_epi8(m2)) |
+                static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                    _mm256_movemask_epi8(m3)))<<32;
+            return first+2*lanes+__builtin_ctzll(high)/sizeof(T);
+        }
+        first+=4*lanes;
+    }
+    return find_sse2(first,last,value);
+}
+
+inline bool cpu_has_avx2()
+{
+    static bool const has_avx2=__builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+inline char const* find_kernel_name()
+{
+#if defined(__x86_64__)
+    return cpu_has_avx2()?"avx2":"sse2";
+#else
+    return "scalar";
+#endif
+}
+
+template<typename T>
+T const* find_contiguous(T const* first,T const* last,T value)
+{
+#if defined(__x86_64__)
+    if(cpu_has_avx2())
+        return find_avx2(first,last,value);
+    return find_sse2(first,last,value);
+#else
+    return std::find(first,last,value);
+#endif
+}
+
+// the leaf of every parallel_find variant: returns the match or last,
+// giving up (and returning last) once done is set
+template<typename Iterator,typename MatchType>
+Iterator find_leaf(Iterator first,Iterator last,MatchType const& match,
+                   std::atomic<bool>& done)
+{
+    if constexpr(use_simd_find<Iterator,MatchType>::value)
+    {
+        typedef typename std::iterator_traits<Iterator>::value_type T;
+        if(first==last)
+            return last;
+        T const* const base=std::addressof(*first);
+        T const* p=base;
+        T const* const end=base+(last-first);
+        std::size_t const block=find_block_bytes/sizeof(T);
+        while(p!=end && !done.load())
+        {
+            T const* const block_end=
+                p+std::min<std::size_t>(block,end-p);
+            T const* const hit=find_contiguous(p,block_end,match);
+            if(hit!=block_end)
+                return first+(hit-base);
+            p=block_end;
+        }
+        return last;
+    }
+    else
+    {
+        for(;(first!=last) && !done.load();++first)
+        {
+            if(*first==match)
+                return first;
+        }
+        return last;
+    }
+}
+
+// elements per leaf: whole SIMD blocks where the kernel applies
+template<typename Iterator,typename MatchType>
+constexpr unsigned long find_min_per_thread()
+{
+    typedef typename std::iterator_traits<Iterator>::value_type T;
+    return use_simd_find<Iterator,MatchType>::value?
+        simd_leaf_bytes/sizeof(T):25;
+}
+
+/*
+Partitioners decide how small the algorithms below cut their work.
+fixed_partitioner keeps a fixed grain, by default the algorithm's own
+min_per_thread. auto_partitioner measures instead: it aims for leaves of
+about target_duration (50us by default), long enough that the task
+overhead is noise and short enough that the work still spreads over every
+core. Before the first split, calibrate() runs doubling prefixes of the
+range (1, 2, 4, ... elements, which is useful work, not a dry run) until
+one takes target_duration/8. That gives a cost per element, and the grain
+is then target_duration divided by that cost. Every leaf reports its time,
+and a moving average keeps the estimate current, so later splits in the
+same call and later calls coarsen or refine as the cost changes.
+One auto_partitioner is meant to be reused across calls on similar work;
+only the first call calibrates. The estimate is shared by every thread
+through a relaxed atomic: a lost update costs one sample, nothing more.
+The algorithms call three things, so a partitioner is any type with:
+- grain_size(default_grain): the minimum elements per leaf;
+- calibrate(length,body): runs body(begin,end) on a prefix, stops early
+  when body returns true, and returns how many elements it did;
+- run_leaf(leaf): runs a leaf that returns how many elements it handled
+  (0 when that is unknown, e.g. a cancelled search).
+*/
+class fixed_partitioner
+{
+    unsigned long const grain;
+public:
+    explicit fixed_partitioner(unsigned long grain_=0):
+        grain(grain_)
+    {}
+
+    unsigned long grain_size(unsigned long default_grain) const
+    {
+        return grain?grain:default_grain;
+    }
+
+    template<typename Body>
+    unsigned long calibrate(unsigned long,Body)
+    {
+        return 0;
+    }
+
+    template<typename Leaf>
+    void run_leaf(Leaf leaf)
+    {
+        leaf();
+    }
+};
+
+class auto_partitioner
+{
+    typedef std::chrono::steady_clock clock;
+    double const target_ns;
+    std::atomic<double> ns_per_element;     // 0 until calibrated
+
+    void record(unsigned long elements,clock::duration elapsed)
+    {
+        if(!elements)
+            return;
+        double const sample=
+            std::chrono::duration<double,std::nano>(elapsed).count()/elements;
+        double const old=ns_per_element.load(std::memory_order_relaxed);
+        ns_per_element.store(old>0?0.75*old+0.25*sample:sample,
+                             std::memory_order_relaxed);
+    }
+
+public:
+    explicit auto_partitioner(
+        std::chrono::nanoseconds target_duration=
+            std::chrono::microseconds(50)):
+        target_ns(static_cast<double>(target_duration.count())),
+        ns_per_element(0)
+    {
+        if(target_duration.count()<=0)
+            throw std::invalid_argument(
+                "auto_partitioner: target duration must be positive");
+    }
+
+    auto_partitioner(auto_partitioner const&)=delete;
+    auto_partitioner& operator=(auto_partitioner const&)=delete;
+
+    unsigned long grain_size(unsigned long default_grain) const
+    {
+        double const cost=ns_per_element.load(std::memory_order_relaxed);
+        if(cost<=0)
+            return default_grain;
+        double const grain=target_ns/cost;
+        return grain<1?1:grain>1e15?1000000000000000ul:
+            static_cast<unsigned long>(grain);
+    }
+
+    template<typename Body>
+    unsigned long calibrate(unsigned long length,Body body)
+    {
+        if(ns_per_element.load(std::memory_order_relaxed)>0)
+            return 0;
+        unsigned long done=0;
+        for(unsigned long chunk=1;done<length;chunk*=2)
+        {
+            unsigned long const n=std::min(chunk,length-done);
+            clock::time_point const start=clock::now();
+            bool const stop=body(done,done+n);
+            clock::duration const elapsed=clock::now()-start;
+            record(n,elapsed);
+            done+=n;
+            if(stop || std::chrono::duration<double,std::nano>(
+                   elapsed).count()>=target_ns/8)
+                break;
+        }
+        return done;
+    }
+
+    template<typename Leaf>
+    void run_leaf(Leaf leaf)
+    {
+        clock::time_point const start=clock::now();
+        unsigned long const elements=leaf();
+        record(elements,clock::now()-start);
+    }
+};
+
+// elements a find leaf examined, for run_leaf: unknown (0) when it gave
+// up because done was set elsewhere
+template<typename Iterator>
+unsigned long find_leaf_examined(Iterator first,Iterator found,Iterator last,
+                                 std::atomic<bool> const& done)
+{
+    if(found!=last)
+        return std::distance(first,found)+1;
+    return done.load()?0:std::distance(first,last);
+}
+
+template<typename Iterator>
+constexpr bool is_random_access()
+{
+    return std::is_base_of<
+        std::random_access_iterator_tag,
+        typename std::iterator_traits<Iterator>::iterator_category>::value;
+}
+
+// defined with the forward searches below
+template<typename Iterator,typename Predicate>
+Iterator forward_find_if(Iterator first,Iterator last,Predicate pred);
+
+template<typename Iterator,typename MatchType,typename Partitioner>
+Iterator parallel_find_promise(Iterator first,Iterator last,MatchType match,
+                               Partitioner& partitioner)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        // walked block by block, with no std::distance pass first; the
+        // partitioner's grain is for random access blocks
+        return forward_find_if(first,last,
+                               [&match](auto const& value)
+                               {return value==match;});
+    }
+    else
+    {
+        struct find_element
+        {
+            void operator()(Iterator begin,Iterator end,
+                            MatchType match,
+                            std::promise<Iterator>* result,
+                            std::atomic<bool>* done_flag,
+                            Partitioner* partitioner)
+            {
+                try
+                {
+                    Iterator found=end;
+                    partitioner->run_leaf([&]{
+                        found=find_leaf(begin,end,match,*done_flag);
+                        return find_leaf_examined(begin,found,end,*done_flag);
+                    });
+                    if(found!=end)
+                    {
+                        result->set_value(found);
+                        done_flag->store(true);
+                    }
+                }
+                catch(...)
+                {
+                    try
+                    {
+                        result->set_exception(std::current_exception());
+                        done_flag->store(true);
+                    }
+                    catch(...)
+                    {}
+                }
+            }
+        };
+
+        unsigned long length=std::distance(first,last);
+
+        if(!length)
+            return last;
+
+        {
+            std::atomic<bool> probe_done(false);
+            Iterator found=last;
+            unsigned long const probed=partitioner.calibrate(
+                length,[&](unsigned long begin,unsigned long end){
+                    Iterator const block_first=std::next(first,begin);
+                    Iterator const block_last=std::next(first,end);
+                    Iterator const hit=find_leaf(block_first,block_last,
+                                                 match,probe_done);
+                    if(hit!=block_last)
+                        found=hit;
+                    return found!=last;
+                });
+            if(found!=last)
+                return found;
+            std::advance(first,probed);
+            length-=probed;
+            if(!length)
+                return last;
+        }
+
+        unsigned long const min_per_thread=partitioner.grain_size(
+            find_min_per_thread<Iterator,MatchType>());
+        unsigned long const max_threads=
+            (length+min_per_thread-1)/min_per_thread;
+
+        unsigned long const hardware_threads=
+            std::thread::hardware_concurrency();
+
+        unsigned long const num_threads=
+            std::min(hardware_threads!=0?hardware_threads:2,max_threads);
+
+        unsigned long const block_size=length/num_threads;
+
+        std::promise<Iterator> result;
+        std::atomic<bool> done_flag(false);
+        std::vector<std::thread> threads(num_threads-1);
+        {
+            join_threads joiner(threads);
+
+            Iterator block_start=first;
+            for(unsigned long i=0;i<(num_threads-1);++i)
+            {
+                Iterator block_end=block_start;
+                std::advance(block_end,block_size);
+                threads[i]=std::thread(find_element(),
+                                       block_start,block_end,match,
+                                       &result,&done_flag,&partitioner);
+                block_start=block_end;
+            }
+            find_element()(block_start,last,match,&result,&done_flag,
+                           &partitioner);
+        }
+        if(!done_flag.load())
+        {
+            return last;
+        }
+        return result.get_future().get();
+    }
+}
+
+template<typename Iterator,typename MatchType>
+Iterator parallel_find_promise(Iterator first,Iterator last,MatchType match)
+{
+    fixed_partitioner partitioner;
+    return parallel_find_promise(first,last,match,partitioner);
+}
+
+template<typename Iterator,typename MatchType,typename Partitioner>
+Iterator parallel_find_impl(Iterator first,Iterator last,MatchType match,
+                            std::atomic<bool>& done,Partitioner& partitioner)
+{
+    try
+    {
+        unsigned long const length=std::distance(first,last);
+        unsigned long const min_per_thread=partitioner.grain_size(
+            find_min_per_thread<Iterator,MatchType>());
+        if(length<(2*min_per_thread))
+        {
+            Iterator found=last;
+            partitioner.run_leaf([&]{
+                found=find_leaf(first,last,match,done);
+                return find_leaf_examined(first,found,last,done);
+            });
+            if(found!=last)
+                done=true;
+            return found;
+        }
+        else
+        {
+            Iterator const mid_point=first+(length/2);
+            std::future<Iterator> async_result=std::async(
+                &parallel_find_impl<Iterator,MatchType,Partitioner>,
+                mid_point,last,match,std::ref(done),std::ref(partitioner));
+            Iterator const direct_result=
+                parallel_find_impl(first,mid_point,match,done,partitioner);
+            return (direct_result==mid_point)?
+                async_result.get():direct_result;
+        }
+    }
+    catch(...)
+    {
+        done=true;
+        throw;
+    }
+}
+
+template<typename Iterator,typename MatchType,typename Partitioner>
+Iterator parallel_find(Iterator first,Iterator last,MatchType match,
+                       Partitioner& partitioner)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        // any match will do, and the leftmost is one
+        return forward_find_if(first,last,
+                               [&match](auto const& value)
+                               {return value==match;});
+    }
+    else
+    {
+        std::atomic<bool> done(false);
+        Iterator found=last;
+        unsigned long const probed=partitioner.calibrate(
+            std::distance(first,last),
+            [&](unsigned long begin,unsigned long end){
+                Iterator const hit=find_leaf(first+begin,first+end,match,
+                                             done);
+                if(hit!=first+end)
+                    found=hit;
+                return found!=last;
+            });
+        if(found!=last)
+            return found;
+        return parallel_find_impl(first+probed,last,match,done,partitioner);
+    }
+}
+
+template<typename Iterator,typename MatchType>
+Iterator parallel_find(Iterator first,Iterator last,MatchType match)
+{
+    fixed_partitioner partitioner;
+    return parallel_find(first,last,match,partitioner);
+}
+
+template<typename Iterator,typename MatchType>
+Iterator parallel_find_pooled_impl(thread_pool& pool,
+                                   Iterator first,Iterator last,
+                                   MatchType match,
+                                   std::atomic<bool>& done)
+{
+    try
+    {
+        unsigned long const length=std::distance(first,last);
+        unsigned long const min_per_thread=
+            find_min_per_thread<Iterator,MatchType>();
+        if(length<(2*min_per_thread))
+        {
+            Iterator const found=find_leaf(first,last,match,done);
+            if(found!=last)
+                done=true;
+            return found;
+        }
+        else
+        {
+            Iterator const mid_point=first+(length/2);
+            std::future<Iterator> async_result=pool.submit(
+                [&pool,mid_point,last,match,&done]{
+                    return parallel_find_pooled_impl(
+                        pool,mid_point,last,match,done);
+                });
+            Iterator direct_result=mid_point;
+            std::exception_ptr direct_error;
+            try
+            {
+                direct_result=parallel_find_pooled_impl(
+                    pool,first,mid_point,match,done);
+            }
+            catch(...)
+            {
+                done=true;
+                direct_error=std::current_exception();
+            }
+            // the stolen half still refers to done, so always wait for it,
+            // even when this half threw
+            while(async_result.wait_for(std::chrono::seconds(0))!=
+                  std::future_status::ready)
+            {
+                pool.run_pending_task();
+            }
+            if(direct_error)
+                std::rethrow_exception(direct_error);
+            return (direct_result==mid_point)?
+                async_result.get():direct_result;
+        }
+    }
+    catch(...)
+    {
+        done=true;
+        throw;
+    }
+}
+
+template<typename Iterator,typename MatchType>
+Iterator parallel_find_pooled(thread_pool& pool,
+                              Iterator first,Iterator last,MatchType match)
+{
+    std::atomic<bool> done(false);
+    return pool.run([&]{
+        return parallel_find_pooled_impl(pool,first,last,match,done);
+    });
+}
+
+/*
+Shared core for the ordered and short-circuiting searches. The range is
+cut into fixed blocks that the threads (joined by join_threads, as in
+parallel_find_promise) claim in increasing order from a shared counter.
+Two things stop a thread from claiming more:
+- done, the old done_flag: set once the answer is known (any_of found a
+  match) or an exception was thrown, it stops every worker;
+- bound: the ordered searches lower it to the leftmost hit found so far.
+  A block that starts at or after bound cannot hold the answer, and
+  since blocks are claimed left to right neither can any later one; a
+  block straddling bound is only scanned up to it.
+The body scans [begin,end) (as indices) and is not interrupted inside a
+block, so a block is kept small enough to be cheap to finish.
+The first exception thrown by a body is rethrown by parallel_block_scan.
+*/
+unsigned long const search_block_size=2048;
+
+struct search_control
+{
+    std::atomic<bool> done;
+    std::atomic<unsigned long> bound;
+
+    explicit search_control(unsigned long length):
+        done(false),bound(length)
+    {}
+
+    // lower bound to index unless it is already lower
+    void found_at(unsigned long index)
+    {
+        unsigned long current=bound.load();
+        while(index<current && !bound.compare_exchange_weak(current,index));
+    }
+};
+
+template<typename Body>
+void parallel_block_scan(unsigned long length,unsigned long block_size,
+                         search_control& control,Body body)
+{
+    if(!length)
+        return;
+    unsigned long const num_blocks=(length+block_size-1)/block_size;
+    unsigned long const hardware_threads=
+        std::thread::hardware_concurrency();
+    unsigned long const num_threads=
+        std::min(hardware_threads!=0?hardware_threads:2,num_blocks);
+
+    std::atomic<unsigned long> next_block(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto const scan=[&]
+    {
+        try
+        {
+            for(;;)
+            {
+                unsigned long const begin=next_block.fetch_add(1)*block_size;
+                unsigned long const bound=control.bound.load();
+                if(control.done.load() || begin>=bound)
+                    return;
+                body(begin,std::min(begin+block_size,bound));
+            }
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lk(error_mutex);
+            if(!error)
+                error=std::current_exception();
+            control.done=true;
+        }
+    };
+
+    std::vector<std::thread> threads(num_threads-1);
+    {
+        join_threads joiner(threads);
+        for(unsigned long i=0;i<(num_threads-1);++i)
+        {
+            threads[i]=std::thread(scan);
+        }
+        scan();
+    }
+    if(error)
+        std::rethrow_exception(error);
+}
+
+/*
+Forward iterators (std::list and the like) cannot be cut into blocks
+without walking them, and walking the whole range up front, as
+std::distance does, is a serial O(n) pass before any work starts. Here
+the calling thread is the walker instead: it cuts the range into blocks
+as it goes and hands each one, with the index of its first element, to
+the workers through a bounded queue, so they start on the first block
+while the rest is still being walked. When the queue is full the walker
+runs the block itself rather than wait, which keeps the queue bounded
+without ever blocking the walk; once the range is walked it drains the
+queue with the workers.
+search_control works as in parallel_block_scan, with indices counted
+from first: the walker stops at done or once it reaches bound, and the
+workers skip blocks that start at or after bound.
+*/
+template<typename Iterator>
+struct forward_block
+{
+    unsigned long begin;
+    Iterator first;
+    Iterator last;
+};
+
+template<typename Iterator>
+class forward_block_queue
+{
+    std::mutex m;
+    std::condition_variable block_ready;
+    std::deque<forward_block<Iterator> > blocks;
+    std::size_t const capacity;
+    bool closed;
+public:
+    explicit forward_block_queue(std::size_t capacity_):
+        capacity(capacity_),closed(false)
+    {}
+
+    bool try_push(forward_block<Iterator> const& block)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if(blocks.size()>=capacity)
+                return false;
+            blocks.push_back(block);
+        }
+        block_ready.notify_one();
+        return true;
+    }
+
+    // false once the queue is closed and empty
+    bool wait_and_pop(forward_block<Iterator>& block)
+    {
+        std::unique_lock<std::mutex> lk(m);
+        block_ready.wait(lk,[this]{return closed || !blocks.empty();});
+        if(blocks.empty())
+            return false;
+        block=blocks.front();
+        blocks.pop_front();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            closed=true;
+        }
+        block_ready.notify_all();
+    }
+};
+
+unsigned long const unbounded=std::numeric_limits<unsigned long>::max();
+
+template<typename Iterator,typename Body>
+void parallel_forward_scan(Iterator first,Iterator last,
+                           unsigned long block_size,
+                           search_control& control,Body body)
+{
+    unsigned long const hardware_threads=
+        std::thread::hardware_concurrency();
+    unsigned long const num_workers=
+        (hardware_threads!=0?hardware_threads:2)-1;
+    forward_block_queue<Iterator> queue(4*(num_workers+1));
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto const fail=[&]
+    {
+        std::lock_guard<std::mutex> lk(error_mutex);
+        if(!error)
+            error=std::current_exception();
+        control.done=true;
+    };
+    auto const run=[&](forward_block<Iterator> const& block)
+    {
+        try
+        {
+            if(!control.done.load() && block.begin<control.bound.load())
+                body(block.begin,block.first,block.last);
+        }
+        catch(...)
+        {
+            fail();
+        }
+    };
+    auto const work=[&]
+    {
+        forward_block<Iterator> block;
+        while(queue.wait_and_pop(block))
+            run(block);
+    };
+
+    std::vector<std::thread> threads(num_workers);
+    {
+        join_threads joiner(threads);
+        try
+        {
+            for(unsigned long i=0;i<num_workers;++i)
+            {
+                threads[i]=std::thread(work);
+            }
+            unsigned long begin=0;
+            while(first!=last && !control.done.load() &&
+                  begin<control.bound.load())
+            {
+                forward_block<Iterator> block{begin,first,first};
+                for(unsigned long n=0;n<block_size && block.last!=last;++n)
+                    ++block.last;
+                begin+=block_size;
+                first=block.last;
+                if(!queue.try_push(block))
+                    run(block);
+            }
+        }
+        catch(...)
+        {
+            fail();
+        }
+        queue.close();
+        work();
+    }
+    if(error)
+        std::rethrow_exception(error);
+}
+
+// leftmost match for the forward searches: bound holds its index, and
+// the iterator is kept alongside it
+template<typename Iterator,typename Predicate>
+Iterator forward_find_if(Iterator first,Iterator last,Predicate pred)
+{
+    search_control control(unbounded);
+    std::mutex found_mutex;
+    unsigned long found_index=unbounded;
+    Iterator found=last;
+    parallel_forward_scan(
+        first,last,search_block_size,control,
+        [&](unsigned long begin,Iterator block_first,Iterator block_last)
+        {
+            for(unsigned long i=begin;block_first!=block_last;
+                ++block_first,++i)
+            {
+                if(pred(*block_first))
+                {
+                    std::lock_guard<std::mutex> lk(found_mutex);
+                    if(i<found_index)
+                    {
+                        found_index=i;
+                        found=block_first;
+                    }
+                    control.found_at(i);
+                    return;
+                }
+            }
+        });
+    return found;
+}
+
+/*
+Ordered mode: parallel_find_first returns the leftmost match, as std::find
+does, where parallel_find returns whichever match a thread sees first.
+The work done is about the match position plus one block per thread,
+whatever the thread count. Blocks of SIMD-eligible ranges are a whole
+vectorised leaf.
+*/
+template<typename Iterator,typename MatchType>
+constexpr unsigned long find_ordered_block_size()
+{
+    typedef typename std::iterator_traits<Iterator>::value_type T;
+    return use_simd_find<Iterator,MatchType>::value?
+        simd_leaf_bytes/sizeof(T):search_block_size;
+}
+
+template<typename Iterator,typename MatchType>
+Iterator parallel_find_first(Iterator first,Iterator last,MatchType match)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        return forward_find_if(first,last,
+                               [&match](auto const& value)
+                               {return value==match;});
+    }
+    else
+    {
+        unsigned long const length=std::distance(first,last);
+        search_control control(length);
+        std::atomic<bool> never_done(false);
+        parallel_block_scan(
+            length,find_ordered_block_size<Iterator,MatchType>(),control,
+            [&](unsigned long begin,unsigned long end)
+            {
+                Iterator const found=find_leaf(first+begin,first+end,
+                                               match,never_done);
+                if(found!=first+end)
+                    control.found_at(found-first);
+            });
+        return first+control.bound.load();
+    }
+}
+
+/*
+The predicate family. find_if and mismatch are ordered (leftmost, as in
+the std algorithms); any_of, none_of and all_of stop every worker through
+done at the first hit; count_if has nothing to short-circuit and adds up
+one count per block. Iterators that are not random access go through
+parallel_forward_scan, except in mismatch, which would have to walk two
+ranges in step and uses std::mismatch.
+*/
+template<typename Iterator,typename Predicate>
+Iterator parallel_find_if(Iterator first,Iterator last,Predicate pred)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        return forward_find_if(first,last,pred);
+    }
+    else
+    {
+        unsigned long const length=std::distance(first,last);
+        search_control control(length);
+        parallel_block_scan(
+            length,search_block_size,control,
+            [&](unsigned long begin,unsigned long end)
+            {
+                for(unsigned long i=begin;i<end;++i)
+                {
+                    if(pred(first[i]))
+                    {
+                        control.found_at(i);
+                        return;
+                    }
+                }
+            });
+        return first+control.bound.load();
+    }
+}
+
+template<typename Iterator,typename Predicate>
+bool parallel_any_of(Iterator first,Iterator last,Predicate pred)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        search_control control(unbounded);
+        std::atomic<bool> found(false);
+        parallel_forward_scan(
+            first,last,search_block_size,control,
+            [&](unsigned long,Iterator block_first,Iterator block_last)
+            {
+                if(std::any_of(block_first,block_last,pred))
+                {
+                    found=true;
+                    control.done=true;
+                }
+            });
+        return found.load();
+    }
+    else
+    {
+        unsigned long const length=std::distance(first,last);
+        search_control control(length);
+        std::atomic<bool> found(false);
+        parallel_block_scan(
+            length,search_block_size,control,
+            [&](unsigned long begin,unsigned long end)
+            {
+                for(unsigned long i=begin;i<end;++i)
+                {
+                    if(pred(first[i]))
+                    {
+                        found=true;
+                        control.done=true;
+                        return;
+                    }
+                }
+            });
+        return found.load();
+    }
+}
 
-template<typename Iterator,typename MatchType>
-Iterator parallel_find_promise(Iterator first,Iterator last,MatchType match)
+template<typename Iterator,typename Predicate>
+bool parallel_none_of(Iterator first,Iterator last,Predicate pred)
 {
-    struct find_element
+    return !parallel_any_of(first,last,pred);
+}
+
+template<typename Iterator,typename Predicate>
+bool parallel_all_of(Iterator first,Iterator last,Predicate pred)
+{
+    return !parallel_any_of(first,last,
+                            [&pred](auto const& value){return !pred(value);});
+}
+
+template<typename Iterator,typename Predicate>
+typename std::iterator_traits<Iterator>::difference_type
+parallel_count_if(Iterator first,Iterator last,Predicate pred)
+{
+    if constexpr(!is_random_access<Iterator>())
     {
-        void operator()(Iterator begin,Iterator end,
-                        MatchType match,
-                        std::promise<Iterator>* result,
-                        std::atomic<bool>* done_flag)
-        {
-            try
+        search_control control(unbounded);
+        std::atomic<unsigned long> count(0);
+        parallel_forward_scan(
+            first,last,search_block_size,control,
+            [&](unsigned long,Iterator block_first,Iterator block_last)
             {
-                for(;(begin!=end) && !done_flag->load();++begin)
+                count.fetch_add(std::count_if(block_first,block_last,pred),
+                                std::memory_order_relaxed);
+            });
+        return count.load();
+    }
+    else
+    {
+        unsigned long const length=std::distance(first,last);
+        search_control control(length);
+        std::atomic<unsigned long> count(0);
+        parallel_block_scan(
+            length,search_block_size,control,
+            [&](unsigned long begin,unsigned long end)
+            {
+                unsigned long block_count=0;
+                for(unsigned long i=begin;i<end;++i)
+                {
+                    if(pred(first[i]))
+                        ++block_count;
+                }
+                count.fetch_add(block_count,std::memory_order_relaxed);
+            });
+        return count.load();
+    }
+}
+
+template<typename Iterator1,typename Iterator2,typename BinaryPredicate>
+std::pair<Iterator1,Iterator2> parallel_mismatch(Iterator1 first1,
+                                                 Iterator1 last1,
+                                                 Iterator2 first2,
+                                                 BinaryPredicate pred)
+{
+    if constexpr(!is_random_access<Iterator1>() ||
+                 !is_random_access<Iterator2>())
+    {
+        return std::mismatch(first1,last1,first2,pred);
+    }
+    else
+    {
+        unsigned long const length=std::distance(first1,last1);
+        search_control control(length);
+        parallel_block_scan(
+            length,search_block_size,control,
+            [&](unsigned long begin,unsigned long end)
+            {
+                for(unsigned long i=begin;i<end;++i)
                 {
-                    if(*begin==match)
+                    if(!pred(first1[i],first2[i]))
                     {
-                        result->set_value(begin);
-                        done_flag->store(true);
+                        control.found_at(i);
                         return;
                     }
                 }
+            });
+        unsigned long const index=control.bound.load();
+        return std::make_pair(first1+index,first2+index);
+    }
+}
+
+template<typename Iterator1,typename Iterator2>
+std::pair<Iterator1,Iterator2> parallel_mismatch(Iterator1 first1,
+                                                 Iterator1 last1,
+                                                 Iterator2 first2)
+{
+    return parallel_mismatch(first1,last1,first2,
+                             [](auto const& a,auto const& b){return a==b;});
+}
+
+/*
+Batched lookup: the first position of each of many keys in one pass over
+the haystack, O(haystack+keys) instead of one parallel_find per key.
+The distinct keys go into needle_set, an open-addressing table (linear
+probing, power-of-two size, at most half full) holding key indices, and
+the haystack is scanned once on parallel_block_scan. For each key the
+leftmost position seen so far is lowered with a CAS.
+
+With many keys the table no longer fits in cache, and nearly every
+haystack element probes it just to miss. So above bloom_threshold_bytes a
+blocked Bloom filter goes in front: one 64-bit word per lookup, 3 bits set
+per key, about 16 bits per key, so 10^5 keys need 200 KiB, which stays in
+L2. A miss then costs one load from L2.
+
+Once every key has been seen, no position after the largest first
+position found so far can improve any result (first positions only
+decrease), so bound is lowered to just past it and the scan stops there.
+
+std::hash is the identity for integers, which is useless with a
+power-of-two table, so its result is put through a 64-bit finaliser.
+
+Haystack elements are hashed and compared as keys, so the needles must
+have the haystack's value type: with double elements and int needles the
+lookup would truncate 3.7 to 3 and match it, where std::find would not.
+*/
+std::size_t const bloom_threshold_bytes=1<<18;
+
+template<typename Key>
+class needle_set
+{
+    std::vector<Key> keys;
+    std::vector<std::uint32_t> slots;   // key index+1, 0 for empty
+    std::size_t slot_mask;
+    std::vector<std::uint64_t> bloom;
+    std::size_t bloom_mask;
+
+    static std::uint64_t hash(Key const& key)
+    {
+        std::uint64_t h=std::hash<Key>()(key);
+        h^=h>>33;
+        h*=0xff51afd7ed558ccdull;
+        h^=h>>33;
+        h*=0xc4ceb9fe1a85ec53ull;
+        h^=h>>33;
+        return h;
+    }
+
+    static std::uint64_t bloom_bits(std::uint64_t h)
+    {
+        return (std::uint64_t(1)<<(h&63)) |
+            (std::uint64_t(1)<<((h>>6)&63)) |
+            (std::uint64_t(1)<<((h>>12)&63));
+    }
+
+public:
+    static std::uint32_t const npos=0xffffffffu;
+
+    // key_of_needle[i] receives the index of needle i among the keys
+    template<typename KeyIterator>
+    needle_set(KeyIterator first,KeyIterator last,
+               std::vector<std::uint32_t>& key_of_needle):
+        slot_mask(0),bloom_mask(0)
+    {
+        std::size_t const count=std::distance(first,last);
+        if(count>=npos)
+            throw std::length_error("needle_set: too many needles");
+        std::size_t capacity=16;
+        while(capacity<2*count)
+            capacity*=2;
+        slots.assign(capacity,0);
+        slot_mask=capacity-1;
+        key_of_needle.clear();
+        key_of_needle.reserve(count);
+        for(;first!=last;++first)
+        {
+            Key const& key=*first;
+            std::size_t slot=hash(key)&slot_mask;
+            while(slots[slot] && !(keys[slots[slot]-1]==key))
+                slot=(slot+1)&slot_mask;
+            if(!slots[slot])
+            {
+                keys.push_back(key);
+                slots[slot]=keys.size();
             }
-            catch(...)
+            key_of_needle.push_back(slots[slot]-1);
+        }
+
+        if(capacity*(sizeof(std::uint32_t)+sizeof(Key))>bloom_threshold_bytes)
+        {
+            std::size_t words=1;
+            while(words*4<keys.size())
+                words*=2;
+            bloom.assign(words,0);
+            bloom_mask=words-1;
+            for(auto const& key:keys)
             {
-                try
-                {
-                    result->set_exception(std::current_exception());
-                    done_flag->store(true);
-                }
-                catch(...)
-                {}
+                std::uint64_t const h=hash(key);
+                bloom[(h>>32)&bloom_mask]|=bloom_bits(h);
             }
         }
-    };
+    }
 
-    unsigned long const length=std::distance(first,last);
+    std::size_t size() const
+    {
+        return keys.size();
+    }
 
-    if(!length)
-        return last;
+    // index of the key equal to value, or npos
+    std::uint32_t find(Key const& value) const
+    {
+        std::uint64_t const h=hash(value);
+        if(!bloom.empty())
+        {
+            std::uint64_t const bits=bloom_bits(h);
+            if((bloom[(h>>32)&bloom_mask]&bits)!=bits)
+                return npos;
+        }
+        for(std::size_t slot=h&slot_mask;slots[slot];
+            slot=(slot+1)&slot_mask)
+        {
+            if(keys[slots[slot]-1]==value)
+                return slots[slot]-1;
+        }
+        return npos;
+    }
+};
 
-    unsigned long const min_per_thread=25;
-    unsigned long const max_threads=
-        (length+min_per_thread-1)/min_per_thread;
+// result[i] is the leftmost element equal to the i-th needle, or last
+template<typename Iterator,typename KeyIterator>
+std::vector<Iterator> parallel_find_many(Iterator first,Iterator last,
+                                         KeyIterator needles_first,
+                                         KeyIterator needles_last)
+{
+    typedef typename std::iterator_traits<KeyIterator>::value_type Key;
+    static_assert(std::is_same<
+                      typename std::iterator_traits<Iterator>::value_type,
+                      Key>::value,
+                  "parallel_find_many: needles must have the haystack's "
+                  "value type, as converting either side to the other "
+                  "would not compare like std::find");
+    std::vector<std::uint32_t> key_of_needle;
+    needle_set<Key> const needles(needles_first,needles_last,key_of_needle);
+    std::vector<Iterator> result(key_of_needle.size(),last);
+    if(!needles.size())
+        return result;
 
-    unsigned long const hardware_threads=
-        std::thread::hardware_concurrency();
+    if constexpr(!is_random_access<Iterator>())
+    {
+        std::vector<Iterator> key_found(needles.size(),last);
+        std::vector<bool> seen(needles.size(),false);
+        std::size_t remaining=needles.size();
+        for(;first!=last && remaining;++first)
+        {
+            std::uint32_t const key=needles.find(*first);
+            if(key!=needles.npos && !seen[key])
+            {
+                seen[key]=true;
+                key_found[key]=first;
+                --remaining;
+            }
+        }
+        for(std::size_t i=0;i<key_of_needle.size();++i)
+            result[i]=key_found[key_of_needle[i]];
+    }
+    else
+    {
+        unsigned long const length=std::distance(first,last);
+        std::unique_ptr<std::atomic<unsigned long>[]> const found(
+            new std::atomic<unsigned long>[needles.size()]);
+        for(std::size_t k=0;k<needles.size();++k)
+            found[k].store(unbounded,std::memory_order_relaxed);
+        std::atomic<std::size_t> remaining(needles.size());
+        search_control control(length);
+        parallel_block_scan(
+            length,search_block_size,control,
+            [&](unsigned long begin,unsigned long end)
+            {
+                for(unsigned long i=begin;i<end;++i)
+                {
+                    std::uint32_t const key=needles.find(first[i]);
+                    if(key==needles.npos)
+                        continue;
+                    unsigned long current=
+                        found[key].load(std::memory_order_relaxed);
+                    while(i<current &&
+                          !found[key].compare_exchange_weak(current,i));
+                    if(current==unbounded && remaining.fetch_sub(1)==1)
+                    {
+                        unsigned long latest=0;
+                        for(std::size_t k=0;k<needles.size();++k)
+                            latest=std::max(latest,found[k].load());
+                        control.found_at(latest+1);
+                    }
+                }
+            });
+        for(std::size_t i=0;i<key_of_needle.size();++i)
+        {
+            unsigned long const index=found[key_of_needle[i]].load();
+            if(index!=unbounded)
+                result[i]=first+index;
+        }
+    }
+    return result;
+}
 
-    unsigned long const num_threads=
-        std::min(hardware_threads!=0?hardware_threads:2,max_threads);
+/*
+Multi-pattern search over a memory-mapped file: every occurrence of any
+of a set of byte strings, as (offset,pattern) pairs sorted by offset and
+then pattern index. Overlapping occurrences are all reported.
 
-    unsigned long const block_size=length/num_threads;
+The matcher is an Aho-Corasick automaton flattened into a dense DFA (256
+transitions per state), so each byte costs a single table load. Most of a
+log is not inside any partial match, though, and there the automaton sits
+in the root state, and from the root only the start of some pattern can
+move it. So the scanner skips to the next position that could start a
+pattern with a vectorised filter and only steps the DFA from there.
 
-    std::promise<Iterator> result;
-    std::atomic<bool> done_flag(false);
-    std::vector<std::thread> threads(num_threads-1);
+The filter is Teddy's fingerprint: the patterns are dealt into 8 buckets
+and, for each of the first fingerprint_length bytes (up to 3, no more than
+the shortest pattern), a nibble classifier maps a byte to the buckets
+holding a pattern with that byte at that position: low_table[k][b&15] &
+high_table[k][b>>4]. A position is a candidate when the classes of its
+next fingerprint_length bytes share a bucket; pshufb evaluates that for 32
+positions at once. The test is a superset (nibbles of different patterns
+in one bucket combine), and the DFA rejects whatever it lets through. A
+single first byte is far too weak a filter on text: "user=" alone would
+stop it on every line.
+
+parallel_search cuts the text into search_chunk_bytes chunks and runs them
+on parallel_block_scan. A chunk reports the matches that start inside it,
+so it reads up to longest-pattern-minus-one bytes past its end.
+*/
+struct search_match
+{
+    std::size_t offset;
+    unsigned pattern;
+
+    bool operator<(search_match const& other) const
     {
-        join_threads joiner(threads);
+        return offset<other.offset ||
+            (offset==other.offset && pattern<other.pattern);
+    }
+    bool operator==(search_match const& other) const
+    {
+        return offset==other.offset && pattern==other.pattern;
+    }
+};
 
-        Iterator block_start=first;
-        for(unsigned long i=0;i<(num_threads-1);++i)
-        {
-            Iterator block_end=block_start;
-            std::advance(block_end,block_size);
-            threads[i]=std::thread(find_element(),
-                                   block_start,block_end,match,
-                                   &result,&done_flag);
-            block_start=block_end;
-        }
-        find_element()(block_start,last,match,&result,&done_flag);
+std::size_t const max_fingerprint_length=3;
+
+#if defined(__x86_64__)
+// returns the first candidate position at or after i, or the first
+// position (below end) that it did not examine; reads below text_end only
+__attribute__((target("avx2")))
+inline std::size_t skip_to_candidate_avx2(
+    unsigned char const* text,std::size_t i,std::size_t end,
+    std::size_t text_end,std::size_t fingerprint_length,
+    unsigned char const (*low_table)[16],
+    unsigned char const (*high_table)[16])
+{
+    __m256i low[max_fingerprint_length],high[max_fingerprint_length];
+    for(std::size_t k=0;k<fingerprint_length;++k)
+    {
+        low[k]=_mm256_broadcastsi128_si256(_mm_loadu_si128(
+            reinterpret_cast<__m128i const*>(low_table[k])));
+        high[k]=_mm256_broadcastsi128_si256(_mm_loadu_si128(
+            reinterpret_cast<__m128i const*>(high_table[k])));
     }
-    if(!done_flag.load())
+    __m256i const nibble=_mm256_set1_epi8(0x0f);
+    __m256i const zero=_mm256_setzero_si256();
+    for(;i<end && i+32+fingerprint_length-1<=text_end;i+=32)
     {
-        return last;
+        __m256i buckets=_mm256_set1_epi8(-1);
+        for(std::size_t k=0;k<fingerprint_length;++k)
+        {
+            __m256i const v=_mm256_loadu_si256(
+                reinterpret_cast<__m256i const*>(text+i+k));
+            __m256i const lo=_mm256_shuffle_epi8(
+                low[k],_mm256_and_si256(v,nibble));
+            __m256i const hi=_mm256_shuffle_epi8(
+                high[k],_mm256_and_si256(_mm256_srli_epi16(v,4),nibble));
+            buckets=_mm256_and_si256(buckets,_mm256_and_si256(lo,hi));
+        }
+        unsigned const rejected=static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(buckets,zero)));
+        if(rejected!=0xffffffffu)
+            return i+__builtin_ctz(~rejected);
     }
-    return result.get_future().get();
+    return i;
 }
+#endif
 
-template<typename Iterator,typename MatchType>
-Iterator parallel_find_impl(Iterator first,Iterator last,MatchType match,
-                            std::atomic<bool>& done)
+class multi_pattern_matcher
 {
-    try
+    std::vector<std::string> patterns;
+    std::size_t longest;
+    std::size_t fingerprint_length;
+    std::vector<std::uint32_t> transitions;     // state*256+byte
+    std::vector<std::uint32_t> output_offsets;  // state -> outputs range
+    std::vector<unsigned> outputs;              // pattern indices
+    unsigned char low_table[max_fingerprint_length][16];
+    unsigned char high_table[max_fingerprint_length][16];
+
+    void build_automaton()
     {
-        unsigned long const length=std::distance(first,last);
-        unsigned long const min_per_thread=25;
-        if(length<(2*min_per_thread))
+        std::vector<std::vector<unsigned>> state_outputs(1);
+        std::vector<std::int64_t> go(256,-1);
+        for(unsigned p=0;p<patterns.size();++p)
         {
-            for(;(first!=last) && !done.load();++first)
+            std::size_t state=0;
+            for(unsigned char const c:patterns[p])
             {
-                if(*first==match)
+                if(go[state*256+c]<0)
                 {
-                    done=true;
-                    return first;
+                    go[state*256+c]=state_outputs.size();
+                    state_outputs.emplace_back();
+                    go.resize(go.size()+256,-1);
                 }
+                state=go[state*256+c];
             }
-            return last;
+            state_outputs[state].push_back(p);
         }
-        else
+
+        // breadth first, so a state's failure link is finished before it
+        std::size_t const num_states=state_outputs.size();
+        transitions.assign(num_states*256,0);
+        std::vector<std::uint32_t> fail(num_states,0);
+        std::deque<std::uint32_t> pending;
+        for(unsigned c=0;c<256;++c)
         {
-            Iterator const mid_point=first+(length/2);
-            std::future<Iterator> async_result=
-                std::async(&parallel_find_impl<Iterator,MatchType>,
-                           mid_point,last,match,std::ref(done));
-            Iterator const direct_result=
-                parallel_find_impl(first,mid_point,match,done);
-            return (direct_result==mid_point)?
-                async_result.get():direct_result;
+            if(go[c]>0)
+            {
+                transitions[c]=go[c];
+                pending.push_back(go[c]);
+            }
+        }
+        while(!pending.empty())
+        {
+            std::uint32_t const state=pending.front();
+            pending.pop_front();
+            std::vector<unsigned> const& inherited=state_outputs[fail[state]];
+            state_outputs[state].insert(state_outputs[state].end(),
+                                        inherited.begin(),inherited.end());
+            for(unsigned c=0;c<256;++c)
+            {
+                std::uint32_t const fallback=transitions[fail[state]*256+c];
+                if(go[state*256+c]>0)
+                {
+                    std::uint32_t const child=go[state*256+c];
+                    fail[child]=fallback;
+                    transitions[state*256+c]=child;
+                    pending.push_back(child);
+                }
+                else
+                {
+                    transitions[state*256+c]=fallback;
+                }
+            }
+        }
+
+        output_offsets.assign(1,0);
+        for(auto const& o:state_outputs)
+        {
+            outputs.insert(outputs.end(),o.begin(),o.end());
+            output_offsets.push_back(outputs.size());
         }
     }
-    catch(...)
+
+    void build_filter()
     {
-        done=true;
-        throw;
+        std::memset(low_table,0,sizeof(low_table));
+        std::memset(high_table,0,sizeof(high_table));
+        for(unsigned p=0;p<patterns.size();++p)
+        {
+            unsigned char const bit=static_cast<unsigned char>(1u<<(p%8));
+            for(std::size_t k=0;k<fingerprint_length;++k)
+            {
+                unsigned char const c=patterns[p][k];
+                low_table[k][c&15]|=bit;
+                high_table[k][c>>4]|=bit;
+            }
+        }
+    }
+
+    bool is_candidate(unsigned char const* text,std::size_t i,
+                      std::size_t text_end) const
+    {
+        if(i+fingerprint_length>text_end)
+            return false;
+        unsigned buckets=0xff;
+        for(std::size_t k=0;k<fingerprint_length;++k)
+        {
+            unsigned char const c=text[i+k];
+            buckets&=low_table[k][c&15]&high_table[k][c>>4];
+        }
+        return buckets!=0;
+    }
+
+    std::size_t skip_to_candidate(unsigned char const* text,std::size_t i,
+                                  std::size_t end,std::size_t text_end) const
+    {
+#if defined(__x86_64__)
+        if(cpu_has_avx2())
+            i=skip_to_candidate_avx2(text,i,end,text_end,fingerprint_length,
+                                     low_table,high_table);
+#endif
+        while(i<end && !is_candidate(text,i,text_end))
+            ++i;
+        return i;
+    }
+
+public:
+    explicit multi_pattern_matcher(std::vector<std::string> patterns_):
+        patterns(std::move(patterns_)),longest(0),
+        fingerprint_length(max_fingerprint_length)
+    {
+        if(patterns.empty())
+            throw std::invalid_argument("multi_pattern_matcher: no patterns");
+        for(auto const& p:patterns)
+        {
+            if(p.empty())
+                throw std::invalid_argument(
+                    "multi_pattern_matcher: empty pattern");
+            longest=std::max(longest,p.size());
+            fingerprint_length=std::min(fingerprint_length,p.size());
+        }
+        build_automaton();
+        build_filter();
+    }
+
+    std::size_t longest_pattern() const
+    {
+        return longest;
+    }
+
+    // appends the matches starting in [begin,report_end) to found, in
+    // order of their end offset; reads no further than text_end
+    void scan(unsigned char const* text,std::size_t begin,
+              std::size_t report_end,std::size_t text_end,
+              std::vector<search_match>& found) const
+    {
+        std::size_t const scan_end=
+            std::min(text_end,report_end+longest-1);
+        std::uint32_t state=0;
+        std::size_t i=begin;
+        while(i<scan_end)
+        {
+            if(!state)
+            {
+                i=skip_to_candidate(text,i,std::min(scan_end,report_end),
+                                    text_end);
+                if(i>=report_end)
+                    return;
+            }
+            state=transitions[state*256+text[i++]];
+            for(std::uint32_t o=output_offsets[state];
+                o!=output_offsets[state+1];++o)
+            {
+                std::size_t const start=i-patterns[outputs[o]].size();
+                if(start<report_end)
+                    found.push_back(search_match{start,outputs[o]});
+            }
+        }
+    }
+};
+
+class mapped_file
+{
+    void* data_;
+    std::size_t size_;
+
+public:
+    explicit mapped_file(std::string const& path):
+        data_(nullptr),size_(0)
+    {
+        int const fd=::open(path.c_str(),O_RDONLY);
+        if(fd<0)
+            throw std::system_error(errno,std::generic_category(),
+                                    "open "+path);
+        struct stat info;
+        if(::fstat(fd,&info)<0)
+        {
+            int const error=errno;
+            ::close(fd);
+            throw std::system_error(error,std::generic_category(),
+                                    "fstat "+path);
+        }
+        size_=info.st_size;
+        if(size_)
+        {
+            data_=::mmap(nullptr,size_,PROT_READ,MAP_PRIVATE,fd,0);
+            if(data_==MAP_FAILED)
+            {
+                int const error=errno;
+                ::close(fd);
+                throw std::system_error(error,std::generic_category(),
+                                        "mmap "+path);
+            }
+            ::madvise(data_,size_,MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    mapped_file(mapped_file const&)=delete;
+    mapped_file& operator=(mapped_file const&)=delete;
+
+    ~mapped_file()
+    {
+        if(data_)
+            ::munmap(data_,size_);
     }
+
+    unsigned char const* data() const
+    {
+        return static_cast<unsigned char const*>(data_);
+    }
+    std::size_t size() const
+    {
+        return size_;
+    }
+};
+
+unsigned long const search_chunk_bytes=1<<20;
+
+inline std::vector<search_match> parallel_search(
+    unsigned char const* text,std::size_t size,
+    multi_pattern_matcher const& matcher)
+{
+    unsigned long const num_chunks=
+        (size+search_chunk_bytes-1)/search_chunk_bytes;
+    std::vector<std::vector<search_match>> chunk_matches(num_chunks);
+    search_control control(size);
+    parallel_block_scan(
+        size,search_chunk_bytes,control,
+        [&](unsigned long begin,unsigned long end)
+        {
+            std::vector<search_match>& found=
+                chunk_matches[begin/search_chunk_bytes];
+            matcher.scan(text,begin,end,size,found);
+            std::sort(found.begin(),found.end());
+        });
+
+    std::size_t total=0;
+    for(auto const& m:chunk_matches)
+        total+=m.size();
+    std::vector<search_match> result;
+    result.reserve(total);
+    for(auto const& m:chunk_matches)
+        result.insert(result.end(),m.begin(),m.end());
+    return result;
 }
 
-template<typename Iterator,typename MatchType>
-Iterator parallel_find(Iterator first,Iterator last,MatchType match)
+inline std::vector<search_match> parallel_search(
+    std::string const& path,std::vector<std::string> const& patterns)
 {
-    std::atomic<bool> done(false);
-    return parallel_find_impl(first,last,match,done);
+    multi_pattern_matcher const matcher(patterns);
+    mapped_file const file(path);
+    return parallel_search(file.data(),file.size(),matcher);
+}
+
+void benchmark_parallel_find()
+{
+  unsigned long const size=1000000;
+  unsigned const repeats=5;
+  std::vector<int> data(size);
+  std::iota(data.begin(),data.end(),0);
+  int const match=static_cast<int>(size-1);
+
+  auto start=std::chrono::high_resolution_clock::now();
+  for(unsigned r=0;r<repeats;++r)
+    parallel_find(data.begin(),data.end(),match);
+  auto stop=std::chrono::high_resolution_clock::now();
+  double const async_seconds=
+    std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+  std::cout<<"std::async find: "<<size*repeats/async_seconds/1e6
+  <<" Melem/s"<<std::endl;
+
+  unsigned const hardware_threads=
+    std::max(std::thread::hardware_concurrency(),1u);
+  for(unsigned cores=1;cores<=hardware_threads;++cores)
+  {
+    thread_pool pool(cores);
+    start=std::chrono::high_resolution_clock::now();
+    for(unsigned r=0;r<repeats;++r)
+      parallel_find_pooled(pool,data.begin(),data.end(),match);
+    stop=std::chrono::high_resolution_clock::now();
+    double const pool_seconds=
+      std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+    std::cout<<"pool find, "<<cores<<" cores: "
+    <<size*repeats/pool_seconds/1e6<<" Melem/s"<<std::endl;
+  }
+}
+
+// scan throughput with the match in the last element, so every variant
+// reads the whole range
+template<typename T>
+void benchmark_find_bandwidth_for(char const* name)
+{
+  std::size_t const bytes=std::size_t(1)<<27;
+  unsigned const repeats=5;
+  std::vector<T> data(bytes/sizeof(T),T(1));
+  data.back()=T(2);
+  T const match=T(2);
+
+  auto const gb_per_second=[&](auto find)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    bool found=true;
+    for(unsigned r=0;r<repeats;++r)
+      found=found && find()==data.end()-1;
+    auto const stop=std::chrono::high_resolution_clock::now();
+    double const seconds=
+      std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+    return found?bytes*double(repeats)/seconds/1e9:0.0;
+  };
+
+  double const scalar=gb_per_second([&]{
+      return std::find(data.begin(),data.end(),match);
+    });
+  double const kernel=gb_per_second([&]{
+      T const* const p=data.data();
+      return data.begin()+
+        (find_contiguous(p,p+data.size(),match)-p);
+    });
+  double const promise=gb_per_second([&]{
+      return parallel_find_promise(data.begin(),data.end(),match);
+    });
+  thread_pool pool(std::max(std::thread::hardware_concurrency(),1u));
+  double const pooled=gb_per_second([&]{
+      return parallel_find_pooled(pool,data.begin(),data.end(),match);
+    });
+  std::cout<<name<<" find GB/s: std::find "<<scalar<<", "
+  <<find_kernel_name()<<" kernel "<<kernel<<", parallel_find_promise "
+  <<promise<<", parallel_find_pooled "<<pooled<<std::endl;
+}
+
+void benchmark_find_bandwidth()
+{
+  benchmark_find_bandwidth_for<char>("char");
+  benchmark_find_bandwidth_for<int>("int");
+  benchmark_find_bandwidth_for<float>("float");
+}
+
+// leftmost match at several positions, with a second match further right
+// that the unordered variants may return instead
+void benchmark_find_first()
+{
+  std::size_t const size=std::size_t(1)<<25;
+  unsigned const repeats=5;
+  std::vector<int> data(size,1);
+  double const positions[]={0.0,0.01,0.1,0.5,0.9};
+
+  auto const seconds=[&](auto find)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    for(unsigned r=0;r<repeats;++r)
+      find();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+      /repeats;
+  };
+
+  for(double position: positions)
+  {
+    std::size_t const index=static_cast<std::size_t>(position*(size-1));
+    std::size_t const later=index+(size-index)/2;
+    data[index]=2;
+    data[later]=2;
+
+    std::vector<int>::iterator expected,unordered,ordered;
+    double const t_find=seconds([&]{
+        expected=std::find(data.begin(),data.end(),2);
+      });
+    double const t_promise=seconds([&]{
+        unordered=parallel_find_promise(data.begin(),data.end(),2);
+      });
+    double const t_first=seconds([&]{
+        ordered=parallel_find_first(data.begin(),data.end(),2);
+      });
+    std::cout<<"match at "<<position*100<<"%: std::find "<<t_find*1e3
+    <<" ms, parallel_find_promise "<<t_promise*1e3<<" ms"
+    <<(unordered==expected?"":" (not leftmost)")
+    <<", parallel_find_first "<<t_first*1e3<<" ms"
+    <<(ordered==expected?"":" (WRONG)")<<std::endl;
+
+    data[index]=1;
+    data[later]=1;
+  }
+}
+
+// the short-circuiting queries against their std counterparts, with the
+// deciding element halfway through
+void benchmark_predicate_family()
+{
+  std::size_t const size=std::size_t(1)<<25;
+  std::vector<int> data(size);
+  std::iota(data.begin(),data.end(),0);
+  std::vector<int> other(data);
+  int const half=static_cast<int>(size/2);
+  other[size/2]=-1;
+  auto const is_half=[half](int x){return x==half;};
+  auto const is_even=[](int x){return x%2==0;};
+
+  auto const ms=[](auto f)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    f();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::milli>(stop-start).count();
+  };
+
+  std::vector<int>::iterator std_found,par_found;
+  bool std_any=false,par_any=true;
+  long std_count=0,par_count=1;
+  std::pair<std::vector<int>::iterator,std::vector<int>::iterator>
+    std_diff,par_diff;
+  std::cout<<"find_if: std "
+  <<ms([&]{std_found=std::find_if(data.begin(),data.end(),is_half);})
+  <<" ms, parallel "
+  <<ms([&]{par_found=parallel_find_if(data.begin(),data.end(),is_half);})
+  <<" ms";
+  std::cout<<"; any_of: std "
+  <<ms([&]{std_any=std::any_of(data.begin(),data.end(),is_half);})
+  <<" ms, parallel "
+  <<ms([&]{par_any=parallel_any_of(data.begin(),data.end(),is_half);})
+  <<" ms";
+  std::cout<<"; count_if: std "
+  <<ms([&]{std_count=std::count_if(data.begin(),data.end(),is_even);})
+  <<" ms, parallel "
+  <<ms([&]{par_count=parallel_count_if(data.begin(),data.end(),is_even);})
+  <<" ms";
+  std::cout<<"; mismatch: std "
+  <<ms([&]{std_diff=std::mismatch(data.begin(),data.end(),other.begin());})
+  <<" ms, parallel "
+  <<ms([&]{par_diff=parallel_mismatch(data.begin(),data.end(),
+                                      other.begin());})
+  <<" ms";
+  bool const correct=std_found==par_found && std_any==par_any &&
+    std_count==par_count && std_diff==par_diff;
+  std::cout<<(correct?"":" (WRONG RESULT)")<<std::endl;
+}
+
+// a synthetic log searched for a handful of needles, against grep -F on
+// the same file (grep counts matching lines, so only the times compare)
+void benchmark_parallel_search()
+{
+  std::filesystem::path const dir=std::filesystem::temp_directory_path();
+  std::string const log_path=(dir/"parallel_search_bench.log").string();
+  std::string const pattern_path=(dir/"parallel_search_bench.pat").string();
+  // not /dev/null: grep stops at the first match when it writes there
+  std::string const count_path=(dir/"parallel_search_bench.out").string();
+  std::vector<std::string> const patterns{
+    "ERROR","connection reset","timeout after","user=4711",
+    "segfault","OutOfMemory","disk full","retrying request"};
+  std::size_t const target_bytes=std::size_t(256)<<20;
+  {
+    char const* const levels[]={"INFO","DEBUG","WARN","INFO","INFO"};
+    char const* const messages[]={
+      "request served in 12ms","cache hit for key","opened session",
+      "flushed write buffer","scheduled compaction","heartbeat ok"};
+    std::mt19937 rng(31);
+    std::ofstream out(log_path,std::ios::binary);
+    std::string line;
+    for(std::size_t written=0;written<target_bytes;written+=line.size())
+    {
+      line="2024-05-01T12:00:00 ";
+      if(rng()%2000==0)
+        line+=patterns[rng()%patterns.size()];
+      else
+        line+=levels[rng()%5];
+      line+=" worker-"+std::to_string(rng()%64)+" ";
+      line+=messages[rng()%6];
+      line+=" user="+std::to_string(rng()%100000)+"\n";
+      out<<line;
+    }
+    std::ofstream pattern_file(pattern_path);
+    for(auto const& p:patterns)
+      pattern_file<<p<<"\n";
+  }
+
+  double const gb=static_cast<double>(
+    std::filesystem::file_size(log_path))/1e9;
+  auto const start=std::chrono::high_resolution_clock::now();
+  std::vector<search_match> const found=parallel_search(log_path,patterns);
+  auto const mid=std::chrono::high_resolution_clock::now();
+  int const status=std::system(
+    ("grep -F -c -f "+pattern_path+" "+log_path+" >"+count_path).c_str());
+  auto const stop=std::chrono::high_resolution_clock::now();
+
+  std::chrono::duration<double> const ours=mid-start;
+  std::chrono::duration<double> const grep=stop-mid;
+
+  // every occurrence of every pattern, overlapping ones included
+  std::vector<search_match> naive;
+  {
+    std::ifstream in(log_path,std::ios::binary);
+    std::string const text((std::istreambuf_iterator<char>(in)),
+                           std::istreambuf_iterator<char>());
+    for(unsigned p=0;p<patterns.size();++p)
+      for(std::size_t pos=text.find(patterns[p]);pos!=std::string::npos;
+          pos=text.find(patterns[p],pos+1))
+        naive.push_back(search_match{pos,p});
+    std::sort(naive.begin(),naive.end());
+  }
+
+  std::cout<<"parallel_search ("<<find_kernel_name()<<" filter) "
+  <<found.size()<<" matches, "<<gb/ours.count()<<" GB/s";
+  if(status==0 || (WIFEXITED(status) && WEXITSTATUS(status)==1))
+    std::cout<<"; grep -F "<<gb/grep.count()<<" GB/s";
+  else
+    std::cout<<"; grep -F unavailable";
+  std::cout<<(found==naive?"":" (WRONG RESULT)")<<std::endl;
+  std::filesystem::remove(log_path);
+  std::filesystem::remove(pattern_path);
+  std::filesystem::remove(count_path);
 }
 
+// a std::list searched through the forward-iterator walker, against the
+// std algorithms on the same list
+void benchmark_forward_find()
+{
+  std::size_t const size=std::size_t(1)<<22;
+  std::list<int> data;
+  for(std::size_t i=0;i<size;++i)
+    data.push_back(static_cast<int>(i));
+  int const target=static_cast<int>(size*3/4);
+  // enough work per element that walking the list is not all there is
+  auto const slow_match=[target](int x)
+  {
+    return static_cast<int>(std::sqrt(static_cast<double>(x)*x))==target;
+  };
+
+  auto const ms=[](auto f)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    f();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::milli>(stop-start).count();
+  };
+
+  std::list<int>::iterator std_found,par_found;
+  long std_count=0,par_count=1;
+  std::cout<<"list find_if: std "
+  <<ms([&]{std_found=std::find_if(data.begin(),data.end(),slow_match);})
+  <<" ms, parallel "
+  <<ms([&]{par_found=parallel_find_if(data.begin(),data.end(),slow_match);})
+  <<" ms; list count_if: std "
+  <<ms([&]{std_count=std::count_if(data.begin(),data.end(),slow_match);})
+  <<" ms, parallel "
+  <<ms([&]{par_count=parallel_count_if(data.begin(),data.end(),slow_match);})
+  <<" ms"<<(std_found==par_found && std_count==par_count?
+             "":" (WRONG RESULT)")<<std::endl;
+
+  std::list<int>::iterator find_found,promise_found;
+  std::cout<<"list find: std "
+  <<ms([&]{std_found=std::find(data.begin(),data.end(),target);})
+  <<" ms, parallel_find "
+  <<ms([&]{find_found=parallel_find(data.begin(),data.end(),target);})
+  <<" ms, parallel_find_promise "
+  <<ms([&]{promise_found=
+             parallel_find_promise(data.begin(),data.end(),target);})
+  <<" ms"<<(find_found==std_found && promise_found==std_found &&
+            parallel_find(data.begin(),data.end(),-1)==data.end() &&
+            parallel_find_promise(data.begin(),data.end(),-1)==data.end()?
+            "":" (WRONG RESULT)")<<std::endl;
+}
+
+// 10^5 keys against 2^24 ints: one batched pass, against one
+// parallel_find_first per key (timed on a few keys and scaled up)
+void benchmark_find_many()
+{
+  std::size_t const size=std::size_t(1)<<24;
+  std::size_t const num_needles=100000;
+  std::mt19937 rng(17);
+  std::vector<int> haystack(size);
+  for(auto& x:haystack)
+    x=static_cast<int>(rng()>>1);
+  std::vector<int> needles(num_needles);
+  for(std::size_t i=0;i<num_needles;++i)
+    needles[i]=i%2?haystack[rng()%size]:static_cast<int>(rng()>>1);
+
+  auto start=std::chrono::high_resolution_clock::now();
+  std::vector<std::vector<int>::iterator> const found=parallel_find_many(
+    haystack.begin(),haystack.end(),needles.begin(),needles.end());
+  auto stop=std::chrono::high_resolution_clock::now();
+  double const batch_ms=
+    std::chrono::duration<double,std::milli>(stop-start).count();
+
+  std::size_t const sampled=20;
+  bool correct=true;
+  start=std::chrono::high_resolution_clock::now();
+  for(std::size_t i=0;i<sampled;++i)
+    correct=correct && parallel_find_first(
+      haystack.begin(),haystack.end(),needles[i])==found[i];
+  stop=std::chrono::high_resolution_clock::now();
+  double const per_key_ms=
+    std::chrono::duration<double,std::milli>(stop-start).count()/sampled;
+
+  std::cout<<"find "<<num_needles<<" keys: batched "<<batch_ms
+  <<" ms, one parallel_find_first per key ~"
+  <<per_key_ms*num_needles/1000<<" s"
+  <<(correct?"":" (WRONG RESULT)")<<std::endl;
+}
+
+// long long has no SIMD kernel, so the fixed grain is the old 25
+// elements: std::async then starts a thread per 25 elements
+void benchmark_find_partitioner()
+{
+  std::size_t const size=std::size_t(1)<<20;
+  std::vector<long long> data(size);
+  std::iota(data.begin(),data.end(),0);
+  long long const target=static_cast<long long>(size-1);
+
+  auto const ms=[](auto f)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    f();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::milli>(stop-start).count();
+  };
+
+  bool correct=true;
+  fixed_partitioner fixed;
+  auto_partitioner adaptive;
+  std::cout<<"parallel_find long long: fixed grain "
+  <<ms([&]{correct=correct &&
+         *parallel_find(data.begin(),data.end(),target,fixed)==target;})
+  <<" ms, auto_partitioner first call "
+  <<ms([&]{correct=correct &&
+         *parallel_find(data.begin(),data.end(),target,adaptive)==target;})
+  <<" ms, second call "
+  <<ms([&]{correct=correct &&
+         *parallel_find(data.begin(),data.end(),target,adaptive)==target;})
+  <<" ms (grain "<<adaptive.grain_size(0)<<")"
+  <<(correct?"":" (WRONG RESULT)")<<std::endl;
+}
 
 int main()
 {
+  benchmark_parallel_find();
+  benchmark_find_bandwidth();
+  benchmark_find_first();
+  benchmark_find_partitioner();
+  benchmark_predicate_family();
+  benchmark_forward_find();
+  benchmark_find_many();
+  benchmark_parallel_search();
   return 0;
 }
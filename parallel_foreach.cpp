@@ -8,6 +8,24 @@
 #include <iostream>
 #include <new>
 #include <numeric>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <functional>
+#include <unistd.h>
 
 /*
 The key things to bear in mind when designing your data structures for 
@@ -113,15 +131,667 @@ public:
     }
 };
 
+class function_wrapper
+{
+    struct impl_base
+    {
+        virtual void call()=0;
+        virtual ~impl_base() {}
+    };
+    std::unique_ptr<impl_base> impl;
+    template<typename F>
+    struct impl_type: impl_base
+    {
+        F f;
+        impl_type(F&& f_): f(std::move(f_)) {}
+        void call() { f(); }
+    };
+public:
+    template<typename F>
+    function_wrapper(F&& f):
+        impl(new impl_type<F>(std::move(f)))
+    {}
+    void operator()() { impl->call(); }
+    function_wrapper()=default;
+    function_wrapper(function_wrapper&& other):
+        impl(std::move(other.impl))
+    {}
+    function_wrapper& operator=(function_wrapper&& other)
+    {
+        impl=std::move(other.impl);
+        return *this;
+    }
+    function_wrapper(const function_wrapper&)=delete;
+    function_wrapper(function_wrapper&)=delete;
+    function_wrapper& operator=(const function_wrapper&)=delete;
+};
+
+/*
+Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli,
+"Correct and Efficient Work-Stealing for Weak Memory Models").
+The owning thread pushes and pops at the bottom without any lock; other
+threads steal from the top and only contend with each other (and with the
+owner on the last element) through a CAS on top.
+Arrays replaced by grow() are kept until destruction because a thief may
+still be reading from them.
+*/
+class work_stealing_queue
+{
+private:
+    typedef function_wrapper* data_type;
+    struct circular_array
+    {
+        long const size;
+        std::unique_ptr<std::atomic<data_type>[]> buffer;
+        explicit circular_array(long size_):
+            size(size_),buffer(new std::atomic<data_type>[size_])
+        {}
+        data_type get(long i) const
+        {
+            return buffer[i&(size-1)].load(std::memory_order_relaxed);
+        }
+        void put(long i,data_type x)
+        {
+            buffer[i&(size-1)].store(x,std::memory_order_relaxed);
+        }
+        circular_array* grow(long bottom,long top) const
+        {
+            circular_array* const a=new circular_array(2*size);
+            for(long i=top;i!=bottom;++i)
+            {
+                a->put(i,get(i));
+            }
+            return a;
+        }
+    };
+    std::atomic<long> top;
+    std::atomic<long> bottom;
+    std::atomic<circular_array*> array;
+    std::vector<std::unique_ptr<circular_array> > old_arrays;
+public:
+    work_stealing_queue():
+        top(0),bottom(0),array(new circular_array(64))
+    {}
+    work_stealing_queue(const work_stealing_queue& other)=delete;
+    work_stealing_queue& operator=(
+        const work_stealing_queue& other)=delete;
+    ~work_stealing_queue()
+    {
+        data_type task;
+        while(try_pop(task))
+        {
+            delete task;
+        }
+        delete array.load();
+    }
+
+    void push(data_type x)
+    {
+        long const b=bottom.load(std::memory_order_relaxed);
+        long const t=top.load(std::memory_order_acquire);
+        circular_array* a=array.load(std::memory_order_relaxed);
+        if(b-t>a->size-1)
+        {
+            old_arrays.emplace_back(a);
+            a=a->grow(b,t);
+            array.store(a,std::memory_order_release);
+        }
+        a->put(b,x);
+        bottom.store(b+1,std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_relaxed)<=
+            top.load(std::memory_order_relaxed);
+    }
+
+    bool try_pop(data_type& res)
+    {
+        long const b=bottom.load(std::memory_order_relaxed)-1;
+        circular_array* const a=array.load(std::memory_order_relaxed);
+        bottom.store(b,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t=top.load(std::memory_order_relaxed);
+        if(t>b)
+        {
+            bottom.store(b+1,std::memory_order_relaxed);
+            return false;
+        }
+        res=a->get(b);
+        if(t==b)
+        {
+            bool const won=top.compare_exchange_strong(
+                t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+            bottom.store(b+1,std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool try_steal(data_type& res)
+    {
+        long t=top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long const b=bottom.load(std::memory_order_acquire);
+        if(t>=b)
+        {
+            return false;
+        }
+        circular_array* const a=array.load(std::memory_order_acquire);
+        res=a->get(t);
+        return top.compare_exchange_strong(
+            t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed);
+    }
+};
+
+/*
+Fixed-size pool: every worker owns a work_stealing_queue, tasks submitted
+from a worker go to its own queue, tasks submitted from outside go to a
+shared queue. An idle worker steals from a randomly chosen victim.
+A task waiting on a future from the pool should call run_pending_task()
+in its wait loop so nested splits never deadlock. Outside callers enter
+through run(), which hands the whole job to a worker: that way every split
+is popped LIFO from a worker's own deque and the helping recursion stays
+as deep as the split tree rather than the number of queued tasks.
+*/
+class thread_pool
+{
+    typedef function_wrapper task_type;
+
+    std::atomic_bool done;
+    std::mutex pool_work_mutex;
+    std::deque<task_type*> pool_work_queue;
+    std::vector<std::unique_ptr<work_stealing_queue> > queues;
+    std::vector<std::thread> threads;
+    join_threads joiner;
+
+    static thread_local thread_pool* local_pool;
+    static thread_local work_stealing_queue* local_work_queue;
+    static thread_local unsigned my_index;
+
+    void worker_thread(unsigned my_index_)
+    {
+        my_index=my_index_;
+        local_work_queue=queues[my_index].get();
+        local_pool=this;
+        while(!done)
+        {
+            run_pending_task();
+        }
+    }
+
+    bool pop_task_from_local_queue(task_type*& task)
+    {
+        return local_pool==this && local_work_queue->try_pop(task);
+    }
+
+    bool pop_task_from_pool_queue(task_type*& task)
+    {
+        std::lock_guard<std::mutex> lk(pool_work_mutex);
+        if(pool_work_queue.empty())
+            return false;
+        task=pool_work_queue.front();
+        pool_work_queue.pop_front();
+        return true;
+    }
+
+    bool pop_task_from_other_thread_queue(task_type*& task)
+    {
+        if(queues.empty())
+            return false;
+        thread_local std::minstd_rand rng(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+        unsigned const victim=rng()%queues.size();
+        for(unsigned i=0;i<queues.size();++i)
+        {
+            unsigned const index=(victim+i)%queues.size();
+            if(local_pool==this && index==my_index)
+                continue;
+            if(queues[index]->try_steal(task))
+                return true;
+        }
+        return false;
+    }
+
+public:
+    explicit thread_pool(
+        unsigned const thread_count=std::thread::hardware_concurrency()):
+        done(false),joiner(threads)
+    {
+        if(!thread_count)
+        {
+            throw std::invalid_argument("thread_pool needs at least one thread");
+        }
+        try
+        {
+            for(unsigned i=0;i<thread_count;++i)
+            {
+                queues.push_back(std::unique_ptr<work_stealing_queue>(
+                                     new work_stealing_queue));
+            }
+            for(unsigned i=0;i<thread_count;++i)
+            {
+                threads.push_back(
+                    std::thread(&thread_pool::worker_thread,this,i));
+            }
+        }
+        catch(...)
+        {
+            done=true;
+            throw;
+        }
+    }
+
+    ~thread_pool()
+    {
+        done=true;
+        for(unsigned i=0;i<threads.size();++i)
+        {
+            if(threads[i].joinable())
+                threads[i].join();
+        }
+        for(task_type* task: pool_work_queue)
+        {
+            delete task;
+        }
+    }
+
+    template<typename FunctionType>
+    std::future<typename std::result_of<FunctionType()>::type>
+    submit(FunctionType f)
+    {
+        typedef typename std::result_of<FunctionType()>::type result_type;
+        std::packaged_task<result_type()> task(std::move(f));
+        std::future<result_type> res(task.get_future());
+        task_type* const wrapped=new task_type(std::move(task));
+        if(local_pool==this)
+        {
+            local_work_queue->push(wrapped);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lk(pool_work_mutex);
+            pool_work_queue.push_back(wrapped);
+        }
+        return res;
+    }
+
+    template<typename FunctionType>
+    typename std::result_of<FunctionType()>::type run(FunctionType f)
+    {
+        if(local_pool==this)
+        {
+            return f();
+        }
+        return submit(std::move(f)).get();
+    }
+
+    void run_pending_task()
+    {
+        task_type* task;
+        if(pop_task_from_local_queue(task) ||
+           pop_task_from_pool_queue(task) ||
+           pop_task_from_other_thread_queue(task))
+        {
+            std::unique_ptr<task_type> owned(task);
+            (*owned)();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+thread_local thread_pool* thread_pool::local_pool=nullptr;
+thread_local work_stealing_queue* thread_pool::local_work_queue=nullptr;
+thread_local unsigned thread_pool::my_index=0;
+
+template<typename Iterator>
+constexpr bool is_random_access()
+{
+    return std::is_base_of<
+        std::random_access_iterator_tag,
+        typename std::iterator_traits<Iterator>::iterator_category>::value;
+}
+
+/*
+Partitioners decide how small the algorithms below cut their work.
+fixed_partitioner keeps a fixed grain, by default the algorithm's own
+min_per_thread. auto_partitioner measures instead: it aims for leaves of
+about target_duration (50us by default), long enough that the task
+overhead is noise and short enough that the work still spreads over every
+core. Before the first split, calibrate() runs doubling prefixes of the
+range (1, 2, 4, ... elements, which is useful work, not a dry run) until
+one takes target_duration/8. That gives a cost per element, and the grain
+is then target_duration divided by that cost. Every leaf reports its time,
+and a moving average keeps the estimate current, so later splits in the
+same call and later calls coarsen or refine as the cost changes.
+One auto_partitioner is meant to be reused across calls on similar work;
+only the first call calibrates. The estimate is shared by every thread
+through a relaxed atomic: a lost update costs one sample, nothing more.
+The algorithms call three things, so a partitioner is any type with:
+- grain_size(default_grain): the minimum elements per leaf;
+- calibrate(length,body): runs body(begin,end) on a prefix, stops early
+  when body returns true, and returns how many elements it did;
+- run_leaf(leaf): runs a leaf that returns how many elements it handled
+  (0 when that is unknown, e.g. a cancelled search).
+*/
+class fixed_partitioner
+{
+    unsigned long const grain;
+public:
+    explicit fixed_partitioner(unsigned long grain_=0):
+        grain(grain_)
+    {}
+
+    unsigned long grain_size(unsigned long default_grain) const
+    {
+        return grain?grain:default_grain;
+    }
+
+    template<typename Body>
+    unsigned long calibrate(unsigned long,Body)
+    {
+        return 0;
+    }
+
+    template<typename Leaf>
+    void run_leaf(Leaf leaf)
+    {
+        leaf();
+    }
+};
+
+class auto_partitioner
+{
+    typedef std::chrono::steady_clock clock;
+    double const target_ns;
+    std::atomic<double> ns_per_element;     // 0 until calibrated
+
+    void record(unsigned long elements,clock::duration elapsed)
+    {
+        if(!elements)
+            return;
+        double const sample=
+            std::chrono::duration<double,std::nano>(elapsed).count()/elements;
+        double const old=ns_per_element.load(std::memory_order_relaxed);
+        ns_per_element.store(old>0?0.75*old+0.25*sample:sample,
+                             std::memory_order_relaxed);
+    }
+
+public:
+    explicit auto_partitioner(
+        std::chrono::nanoseconds target_duration=
+            std::chrono::microseconds(50)):
+        target_ns(static_cast<double>(target_duration.count())),
+        ns_per_element(0)
+    {
+        if(target_duration.count()<=0)
+            throw std::invalid_argument(
+                "auto_partitioner: target duration must be positive");
+    }
+
+    auto_partitioner(auto_partitioner const&)=delete;
+    auto_partitioner& operator=(auto_partitioner const&)=delete;
+
+    unsigned long grain_size(unsigned long default_grain) const
+    {
+        double const cost=ns_per_element.load(std::memory_order_relaxed);
+        if(cost<=0)
+            return default_grain;
+        double const grain=target_ns/cost;
+        return grain<1?1:grain>1e15?1000000000000000ul:
+            static_cast<unsigned long>(grain);
+    }
+
+    template<typename Body>
+    unsigned long calibrate(unsigned long length,Body body)
+    {
+        if(ns_per_element.load(std::memory_order_relaxed)>0)
+            return 0;
+        unsigned long done=0;
+        for(unsigned long chunk=1;done<length;chunk*=2)
+        {
+            unsigned long const n=std::min(chunk,length-done);
+            clock::time_point const start=clock::now();
+            bool const stop=body(done,done+n);
+            clock::duration const elapsed=clock::now()-start;
+            record(n,elapsed);
+            done+=n;
+            if(stop || std::chrono::duration<double,std::nano>(
+                   elapsed).count()>=target_ns/8)
+                break;
+        }
+        return done;
+    }
+
+    template<typename Leaf>
+    void run_leaf(Leaf leaf)
+    {
+        clock::time_point const start=clock::now();
+        unsigned long const elements=leaf();
+        record(elements,clock::now()-start);
+    }
+};
+
+unsigned long const default_min_per_thread=25;
+
+/*
+Fork-join pool behind parallel_for_each and the loops below, for loops
+that are short and frequent. thread_pool pays for a heap-allocated task
+and a future per split, and starting a thread per block (as
+parallel_for_each_spawning still does) costs more again; at a few
+thousand calls a second on vectors of a few thousand elements that
+overhead is the whole cost. Here the workers are started once, and a
+call (run) is:
+- a fork_join_job on the caller's stack, with the loop body type-erased
+  into a function pointer and a context pointer, so nothing is allocated;
+- tickets: the caller wants participants-1 helpers and publishes that
+  many tickets, then bumps epoch to wake the workers. A worker that wins a
+  ticket joins in, one that loses goes back to waiting without touching
+  the job, so a small loop does not wait for every worker in the pool;
+- blocks claimed from an atomic counter by the helpers and the caller
+  alike; the caller returns once every helper has checked out.
+Idle workers spin briefly on epoch, then sleep on a condition variable;
+the caller only takes the mutex to notify when someone is asleep.
+A call made from inside a job (a nested loop), or while another thread's
+job holds the pool, runs its blocks on the calling thread instead of
+waiting. The first exception thrown by a block stops the claiming and is
+rethrown by run.
+*/
+class fork_join_pool
+{
+    struct fork_join_job
+    {
+        void (*run_block)(void*,unsigned long);
+        void* context;
+        unsigned long num_blocks;
+        std::atomic<unsigned long> next_block;
+        std::atomic<bool> failed;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+
+        void work()
+        {
+            for(unsigned long block=next_block.fetch_add(1);
+                block<num_blocks && !failed.load(std::memory_order_relaxed);
+                block=next_block.fetch_add(1))
+            {
+                try
+                {
+                    run_block(context,block);
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lk(error_mutex);
+                    if(!error)
+                        error=std::current_exception();
+                    failed=true;
+                }
+            }
+        }
+    };
+
+    std::mutex job_mutex;               // one job at a time
+    fork_join_job* job;
+    std::atomic<unsigned> tickets;
+    std::atomic<unsigned> active;
+    std::atomic<unsigned long> epoch;
+    std::atomic<unsigned> sleepers;
+    std::atomic<bool> done;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::vector<std::thread> threads;
+    join_threads joiner;
+
+    static thread_local fork_join_pool* current_pool;
+
+    bool take_ticket()
+    {
+        unsigned left=tickets.load();
+        while(left && !tickets.compare_exchange_weak(left,left-1));
+        return left!=0;
+    }
+
+    void worker_thread()
+    {
+        current_pool=this;
+        unsigned long seen=0;
+        while(true)
+        {
+            for(unsigned spin=0;epoch.load()==seen && !done.load();++spin)
+            {
+                if(spin<64)
+                    continue;
+                if(spin<128)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lk(sleep_mutex);
+                sleepers.fetch_add(1);
+                wake.wait(lk,[&]{return epoch.load()!=seen || done.load();});
+                sleepers.fetch_sub(1);
+            }
+            if(done.load())
+                return;
+            seen=epoch.load();
+            if(take_ticket())
+            {
+                job->work();
+                active.fetch_sub(1);
+            }
+        }
+    }
+
+public:
+    // thread_count counts the caller, so the pool starts thread_count-1
+    explicit fork_join_pool(
+        unsigned thread_count=std::thread::hardware_concurrency()):
+        job(nullptr),tickets(0),active(0),epoch(0),sleepers(0),done(false),
+        joiner(threads)
+    {
+        if(!thread_count)
+            thread_count=2;
+        try
+        {
+            for(unsigned i=1;i<thread_count;++i)
+            {
+                threads.push_back(
+                    std::thread(&fork_join_pool::worker_thread,this));
+            }
+        }
+        catch(...)
+        {
+            done=true;
+            wake.notify_all();
+            throw;
+        }
+    }
+
+    fork_join_pool(fork_join_pool const&)=delete;
+    fork_join_pool& operator=(fork_join_pool const&)=delete;
+
+    ~fork_join_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(sleep_mutex);
+            done=true;
+        }
+        wake.notify_all();
+    }
+
+    unsigned size() const
+    {
+        return threads.size()+1;
+    }
+
+    // runs body(block) for every block in [0,num_blocks) on up to
+    // participants threads, the caller included
+    template<typename Body>
+    void run(unsigned long num_blocks,unsigned participants,Body& body)
+    {
+        fork_join_job local_job;
+        local_job.run_block=[](void* context,unsigned long block)
+        {
+            (*static_cast<Body*>(context))(block);
+        };
+        local_job.context=&body;
+        local_job.num_blocks=num_blocks;
+        local_job.next_block=0;
+        local_job.failed=false;
+
+        unsigned const helpers=std::min<unsigned long>(
+            std::min<unsigned>(participants,size()),num_blocks)-1;
+        std::unique_lock<std::mutex> lk(job_mutex,std::defer_lock);
+        if(helpers && current_pool!=this && lk.try_lock())
+        {
+            current_pool=this;
+            job=&local_job;
+            active.store(helpers);
+            tickets.store(helpers);
+            epoch.fetch_add(1);
+            if(sleepers.load())
+            {
+                std::lock_guard<std::mutex> sleep_lk(sleep_mutex);
+                wake.notify_all();
+            }
+            local_job.work();
+            // helpers that never got going give their tickets back unused
+            unsigned const unused=tickets.exchange(0);
+            active.fetch_sub(unused);
+            while(active.load())
+                std::this_thread::yield();
+            current_pool=nullptr;
+        }
+        else
+        {
+            local_job.work();
+        }
+        if(local_job.error)
+            std::rethrow_exception(local_job.error);
+    }
+};
+thread_local fork_join_pool* fork_join_pool::current_pool=nullptr;
+
+inline fork_join_pool& default_fork_join_pool()
+{
+    static fork_join_pool pool;
+    return pool;
+}
+
+// the original parallel_for_each, a thread and a future per block on
+// every call; kept as the baseline for benchmark_fork_join_overhead
 template<typename Iterator,typename Func>
-void parallel_for_each(Iterator first,Iterator last,Func f)
+void parallel_for_each_spawning(Iterator first,Iterator last,Func f)
 {
     unsigned long const length=std::distance(first,last);
 
     if(!length)
         return;
 
-    unsigned long const min_per_thread=25;
+    unsigned long const min_per_thread=default_min_per_thread;
     unsigned long const max_threads=
         (length+min_per_thread-1)/min_per_thread;
 
@@ -159,52 +829,1431 @@ void parallel_for_each(Iterator first,Iterator last,Func f)
     }
 }
 
-void parallel_foreach()
-{
-  int max_num = 100;
-	std::vector<int> a(max_num);
-	std::iota(a.begin(), a.end(), 1);
-  parallel_for_each(a.begin(), a.end(), [](auto p)
-  {
-    std::cout << p << std::endl;
-  });
-}
-
-template<typename Iterator,typename Func>
-void parallel_for_each_async(Iterator first,Iterator last,Func f)
+/*
+Forward iterators (std::list and the like): rather than walking the whole
+range with std::distance/std::advance before any work starts, one thread
+walks it as the others run, cutting it into blocks and handing them over
+through a bounded queue. When the queue is full the walker runs the block
+itself instead of waiting, so the walk never blocks; once the range is
+walked it drains the queue with the workers. The walker and the workers
+are the blocks of one fork-join job: block 0 walks, the rest work the
+queue, and since blocks are claimed in order a job run inline on one
+thread walks first. After the first exception no more blocks are
+started, and it is rethrown to the caller.
+*/
+template<typename Iterator>
+class forward_block_queue
 {
-    unsigned long const length=std::distance(first,last);
-
-    if(!length)
-        return;
+    typedef std::pair<Iterator,Iterator> block_type;
+    std::mutex m;
+    std::condition_variable block_ready;
+    std::deque<block_type> blocks;
+    std::size_t const capacity;
+    bool closed;
+public:
+    explicit forward_block_queue(std::size_t capacity_):
+        capacity(capacity_),closed(false)
+    {}
 
-    unsigned long const min_per_thread=25;
+    bool try_push(block_type const& block)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if(blocks.size()>=capacity)
+                return false;
+            blocks.push_back(block);
+        }
+        block_ready.notify_one();
+        return true;
+    }
 
-    if(length<(2*min_per_thread))
+    // false once the queue is closed and empty
+    bool wait_and_pop(block_type& block)
     {
-        std::for_each(first,last,f);
+        std::unique_lock<std::mutex> lk(m);
+        block_ready.wait(lk,[this]{return closed || !blocks.empty();});
+        if(blocks.empty())
+            return false;
+        block=blocks.front();
+        blocks.pop_front();
+        return true;
     }
-    else
+
+    void close()
     {
-        Iterator const mid_point=first+length/2;
-        std::future<void> first_half=
-            std::async(&parallel_for_each_async<Iterator, Func>,
-                        first, mid_point,f);
-        parallel_for_each_async(mid_point,last,f);
-        first_half.get();
+        {
+            std::lock_guard<std::mutex> lk(m);
+            closed=true;
+        }
+        block_ready.notify_all();
     }
-}
+};
 
-void parallel_foreach_async()
+unsigned long const forward_block_size=256;
+
+template<typename Iterator,typename Func>
+void parallel_for_each_forward(Iterator first,Iterator last,Func f)
 {
-  int max_num = 100;
-	std::vector<int> vec(max_num);
-	std::iota(vec.begin(), vec.end(), 1);
+    fork_join_pool& pool=default_fork_join_pool();
+    forward_block_queue<Iterator> queue(4*pool.size());
 
-  parallel_for_each_async(vec.begin(), vec.end(), [](auto p)
-  {
-    std::cout << p << std::endl;
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto const fail=[&]
+    {
+        std::lock_guard<std::mutex> lk(error_mutex);
+        if(!error)
+            error=std::current_exception();
+        failed=true;
+    };
+    auto const run=[&](std::pair<Iterator,Iterator> const& block)
+    {
+        try
+        {
+            if(!failed.load())
+                std::for_each(block.first,block.second,f);
+        }
+        catch(...)
+        {
+            fail();
+        }
+    };
+    auto const work=[&]
+    {
+        std::pair<Iterator,Iterator> block;
+        while(queue.wait_and_pop(block))
+            run(block);
+    };
+
+    auto body=[&](unsigned long block)
+    {
+        if(block)
+        {
+            work();
+            return;
+        }
+        try
+        {
+            while(first!=last && !failed.load())
+            {
+                std::pair<Iterator,Iterator> block(first,first);
+                for(unsigned long n=0;
+                    n<forward_block_size && block.second!=last;++n)
+                    ++block.second;
+                first=block.second;
+                if(!queue.try_push(block))
+                    run(block);
+            }
+        }
+        catch(...)
+        {
+            fail();
+        }
+        queue.close();
+        work();
+    };
+    pool.run(pool.size(),pool.size(),body);
+    if(error)
+        std::rethrow_exception(error);
+}
+
+/*
+Schedules decide how parallel_for_each hands the range to the threads of
+the fork-join pool, in the sense of OpenMP's schedule clause:
+- static_schedule: one equal block per thread, fixed up front. Cheapest,
+  but when the cost per element is skewed the thread with the expensive
+  block finishes last and the others sit idle;
+- dynamic_schedule: chunks of a fixed size (by default the partitioner's
+  grain) claimed from an atomic counter as threads free up;
+- guided_schedule: claimed the same way, but each chunk is the remaining
+  work divided by twice the thread count (never below min_chunk), so
+  there are few claims early and small chunks to even out the tail.
+Chunks are the partitioner's leaves, so auto_partitioner times them.
+*/
+struct static_schedule
+{};
+
+struct dynamic_schedule
+{
+    unsigned long chunk;    // 0: the partitioner's grain
+    explicit dynamic_schedule(unsigned long chunk_=0):
+        chunk(chunk_)
+    {}
+};
+
+struct guided_schedule
+{
+    unsigned long min_chunk;    // 0: the partitioner's grain
+    explicit guided_schedule(unsigned long min_chunk_=0):
+        min_chunk(min_chunk_)
+    {}
+};
+
+template<typename T>
+struct is_schedule: std::false_type
+{};
+template<>
+struct is_schedule<static_schedule>: std::true_type
+{};
+template<>
+struct is_schedule<dynamic_schedule>: std::true_type
+{};
+template<>
+struct is_schedule<guided_schedule>: std::true_type
+{};
+
+// the shared claim counter of a dynamic (divisor 0) or guided schedule
+class chunk_dispenser
+{
+    std::atomic<unsigned long> next;
+    unsigned long const length;
+    unsigned long const chunk;
+    unsigned long const divisor;
+public:
+    chunk_dispenser(unsigned long length_,unsigned long chunk_,
+                    unsigned long divisor_):
+        next(0),length(length_),chunk(chunk_?chunk_:1),divisor(divisor_)
+    {}
+
+    bool claim(unsigned long& begin,unsigned long& end)
+    {
+        if(!divisor)
+        {
+            begin=next.fetch_add(chunk);
+            if(begin>=length)
+                return false;
+            end=std::min(begin+chunk,length);
+            return true;
+        }
+        unsigned long start=next.load();
+        do
+        {
+            if(start>=length)
+                return false;
+            end=start+std::min(std::max(chunk,(length-start)/divisor),
+                               length-start);
+        }
+        while(!next.compare_exchange_weak(start,end));
+        begin=start;
+        return true;
+    }
+};
+
+template<typename Iterator,typename Func,typename Partitioner,
+         typename Schedule>
+void parallel_for_each(Iterator first,Iterator last,Func f,
+                       Partitioner& partitioner,Schedule schedule)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        parallel_for_each_forward(first,last,f);
+    }
+    else
+    {
+        first+=partitioner.calibrate(
+            std::distance(first,last),
+            [&](unsigned long begin,unsigned long end){
+                std::for_each(first+begin,first+end,f);
+                return false;
+            });
+        unsigned long const length=std::distance(first,last);
+
+        if(!length)
+            return;
+
+        unsigned long const min_per_thread=
+            partitioner.grain_size(default_min_per_thread);
+        unsigned long const max_threads=
+            (length+min_per_thread-1)/min_per_thread;
+
+        fork_join_pool& pool=default_fork_join_pool();
+        unsigned long const num_threads=
+            std::min<unsigned long>(pool.size(),max_threads);
+
+        if constexpr(!std::is_same<Schedule,static_schedule>::value)
+        {
+            unsigned long chunk;
+            unsigned long divisor=0;
+            if constexpr(std::is_same<Schedule,dynamic_schedule>::value)
+            {
+                chunk=schedule.chunk;
+            }
+            else
+            {
+                chunk=schedule.min_chunk;
+                divisor=2*num_threads;
+            }
+            chunk_dispenser chunks(length,chunk?chunk:min_per_thread,divisor);
+            // one block per thread, each claiming chunks until none are left
+            auto body=[&](unsigned long)
+            {
+                unsigned long begin,end;
+                while(chunks.claim(begin,end))
+                {
+                    partitioner.run_leaf([&]{
+                        std::for_each(first+begin,first+end,f);
+                        return end-begin;
+                    });
+                }
+            };
+            pool.run(num_threads,num_threads,body);
+        }
+        else
+        {
+            unsigned long const block_size=length/num_threads;
+            auto body=[&](unsigned long block)
+            {
+                Iterator const block_start=first+block*block_size;
+                Iterator const block_end=
+                    block+1<num_threads?block_start+block_size:last;
+                partitioner.run_leaf([&]{
+                    std::for_each(block_start,block_end,f);
+                    return static_cast<unsigned long>(
+                        block_end-block_start);
+                });
+            };
+            pool.run(num_threads,num_threads,body);
+        }
+    }
+}
+
+// the fourth argument is either a partitioner or a schedule
+template<typename Iterator,typename Func,typename Policy>
+void parallel_for_each(Iterator first,Iterator last,Func f,Policy&& policy)
+{
+    if constexpr(is_schedule<typename std::decay<Policy>::type>::value)
+    {
+        fixed_partitioner partitioner;
+        parallel_for_each(first,last,f,partitioner,policy);
+    }
+    else
+    {
+        parallel_for_each(first,last,f,policy,static_schedule());
+    }
+}
+
+template<typename Iterator,typename Func>
+void parallel_for_each(Iterator first,Iterator last,Func f)
+{
+    fixed_partitioner partitioner;
+    parallel_for_each(first,last,f,partitioner,static_schedule());
+}
+
+void parallel_foreach()
+{
+  int max_num = 100;
+	std::vector<int> a(max_num);
+	std::iota(a.begin(), a.end(), 1);
+  parallel_for_each(a.begin(), a.end(), [](auto p)
+  {
+    std::cout << p << std::endl;
+  });
+}
+
+template<typename Iterator,typename Func,typename Partitioner>
+void parallel_for_each_async_impl(Iterator first,Iterator last,Func f,
+                                  Partitioner& partitioner)
+{
+    unsigned long const length=std::distance(first,last);
+
+    if(!length)
+        return;
+
+    unsigned long const min_per_thread=
+        partitioner.grain_size(default_min_per_thread);
+
+    if(length<(2*min_per_thread))
+    {
+        partitioner.run_leaf([&]{
+            std::for_each(first,last,f);
+            return length;
+        });
+    }
+    else
+    {
+        Iterator const mid_point=first+length/2;
+        std::future<void> first_half=std::async(
+            &parallel_for_each_async_impl<Iterator,Func,Partitioner>,
+            first,mid_point,f,std::ref(partitioner));
+        parallel_for_each_async_impl(mid_point,last,f,partitioner);
+        first_half.get();
+    }
+}
+
+template<typename Iterator,typename Func,typename Partitioner>
+void parallel_for_each_async(Iterator first,Iterator last,Func f,
+                             Partitioner& partitioner)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        parallel_for_each_forward(first,last,f);
+    }
+    else
+    {
+        first+=partitioner.calibrate(
+            std::distance(first,last),
+            [&](unsigned long begin,unsigned long end){
+                std::for_each(first+begin,first+end,f);
+                return false;
+            });
+        parallel_for_each_async_impl(first,last,f,partitioner);
+    }
+}
+
+template<typename Iterator,typename Func>
+void parallel_for_each_async(Iterator first,Iterator last,Func f)
+{
+    fixed_partitioner partitioner;
+    parallel_for_each_async(first,last,f,partitioner);
+}
+
+void parallel_foreach_async()
+{
+  int max_num = 100;
+	std::vector<int> vec(max_num);
+	std::iota(vec.begin(), vec.end(), 1);
+
+  parallel_for_each_async(vec.begin(), vec.end(), [](auto p)
+  {
+    std::cout << p << std::endl;
+  });
+}
+
+template<typename Iterator,typename Func>
+void parallel_for_each_pooled_impl(thread_pool& pool,
+                                   Iterator first,Iterator last,Func f)
+{
+    unsigned long const length=std::distance(first,last);
+
+    if(!length)
+        return;
+
+    unsigned long const min_per_thread=25;
+
+    if(length<(2*min_per_thread))
+    {
+        std::for_each(first,last,f);
+    }
+    else
+    {
+        Iterator const mid_point=first+length/2;
+        std::future<void> first_half=pool.submit(
+            [&pool,first,mid_point,f]{
+                parallel_for_each_pooled_impl(pool,first,mid_point,f);
+            });
+        parallel_for_each_pooled_impl(pool,mid_point,last,f);
+        while(first_half.wait_for(std::chrono::seconds(0))!=
+              std::future_status::ready)
+        {
+            pool.run_pending_task();
+        }
+        first_half.get();
+    }
+}
+
+template<typename Iterator,typename Func>
+void parallel_for_each_pooled(thread_pool& pool,
+                              Iterator first,Iterator last,Func f)
+{
+    pool.run([&]{
+        parallel_for_each_pooled_impl(pool,first,last,f);
+    });
+}
+
+
+/*
+Reductions and scans on the fork-join pool. As with std::reduce, op must
+be associative (not necessarily commutative): the range is cut into
+blocks, each block is folded left to right, and the partial results are
+combined in block order, so only the grouping differs from a serial
+loop. For floating point the grouping is the whole story, and there are
+two modes:
+- fast: about four blocks per pool thread (at least reduce_block_size
+  elements each), so the result depends on the thread count;
+- deterministic: blocks of exactly reduce_block_size elements, and the
+  partials combined pairwise in a fixed tree, so the result is the same
+  on every run and every machine whatever the thread count (and the
+  pairwise tree loses less precision than one long chain).
+The scans make two passes over the blocks with a serial pass between
+them: reduce each block, turn the block totals into each block's carry
+(an exclusive scan over at most a few thousand values), then scan each
+block again starting from its carry. They work in place (d_first equal
+to first). Iterators that are not random access use the std algorithm.
+*/
+enum class reduce_mode
+{
+    fast,
+    deterministic
+};
+
+unsigned long const reduce_block_size=4096;
+
+inline unsigned long reduce_block_length(unsigned long length,
+                                         reduce_mode mode)
+{
+    if(mode==reduce_mode::deterministic)
+        return reduce_block_size;
+    unsigned long const per_thread=
+        length/(4ul*default_fork_join_pool().size());
+    return std::max(reduce_block_size,per_thread);
+}
+
+// fold of the block partials: left to right, or pairwise for
+// deterministic mode
+template<typename T,typename BinaryOp>
+T combine_partials(std::vector<std::optional<T> >& partials,BinaryOp op,
+                   reduce_mode mode)
+{
+    if(mode==reduce_mode::fast)
+    {
+        T total=std::move(*partials[0]);
+        for(std::size_t i=1;i<partials.size();++i)
+            total=op(std::move(total),std::move(*partials[i]));
+        return total;
+    }
+    for(std::size_t width=1;width<partials.size();width*=2)
+    {
+        for(std::size_t i=0;i+width<partials.size();i+=2*width)
+            partials[i]=op(std::move(*partials[i]),
+                           std::move(*partials[i+width]));
+    }
+    return std::move(*partials[0]);
+}
+
+template<typename Iterator,typename T,typename ReduceOp,typename TransformOp>
+T parallel_transform_reduce(Iterator first,Iterator last,T init,
+                            ReduceOp reduce,TransformOp transform,
+                            reduce_mode mode=reduce_mode::fast)
+{
+    if constexpr(!is_random_access<Iterator>())
+    {
+        return std::transform_reduce(first,last,init,reduce,transform);
+    }
+    else
+    {
+        unsigned long const length=std::distance(first,last);
+        if(!length)
+            return init;
+        unsigned long const block_length=reduce_block_length(length,mode);
+        unsigned long const num_blocks=(length+block_length-1)/block_length;
+        std::vector<std::optional<T> > partials(num_blocks);
+        auto body=[&](unsigned long block)
+        {
+            Iterator it=first+block*block_length;
+            Iterator const end=
+                first+std::min((block+1)*block_length,length);
+            T partial=transform(*it);
+            for(++it;it!=end;++it)
+                partial=reduce(std::move(partial),transform(*it));
+            partials[block]=std::move(partial);
+        };
+        fork_join_pool& pool=default_fork_join_pool();
+        pool.run(num_blocks,pool.size(),body);
+        return reduce(std::move(init),
+                      combine_partials(partials,reduce,mode));
+    }
+}
+
+template<typename Iterator,typename T,typename BinaryOp>
+T parallel_reduce(Iterator first,Iterator last,T init,BinaryOp op,
+                  reduce_mode mode=reduce_mode::fast)
+{
+    return parallel_transform_reduce(
+        first,last,std::move(init),op,
+        [](auto const& value){return value;},mode);
+}
+
+template<typename Iterator,typename T>
+T parallel_reduce(Iterator first,Iterator last,T init)
+{
+    return parallel_reduce(first,last,std::move(init),std::plus<>());
+}
+
+// carry is empty only for the first block of an inclusive scan without
+// an initial value
+template<typename Iterator,typename OutputIterator,typename T,
+         typename BinaryOp>
+OutputIterator parallel_scan_impl(Iterator first,Iterator last,
+                                  OutputIterator d_first,
+                                  std::optional<T> init,BinaryOp op,
+                                  reduce_mode mode,bool inclusive)
+{
+    unsigned long const length=std::distance(first,last);
+    if(!length)
+        return d_first;
+    unsigned long const block_length=reduce_block_length(length,mode);
+    unsigned long const num_blocks=(length+block_length-1)/block_length;
+    fork_join_pool& pool=default_fork_join_pool();
+    std::vector<std::optional<T> > carries(num_blocks);
+    // pass 1: the total of every block but the last, one slot along
+    auto reduce_block=[&](unsigned long block)
+    {
+        Iterator it=first+block*block_length;
+        Iterator const end=it+block_length;
+        T total=*it;
+        for(++it;it!=end;++it)
+            total=op(std::move(total),*it);
+        carries[block+1]=std::move(total);
+    };
+    pool.run(num_blocks-1,pool.size(),reduce_block);
+    // block carries: exclusive scan over the totals, in block order
+    carries[0]=std::move(init);
+    for(unsigned long block=1;block<num_blocks;++block)
+    {
+        if(carries[block-1])
+            carries[block]=op(*carries[block-1],std::move(*carries[block]));
+    }
+    // pass 2: scan each block from its carry
+    auto scan_block=[&](unsigned long block)
+    {
+        unsigned long const begin=block*block_length;
+        Iterator it=first+begin;
+        Iterator const end=first+std::min(begin+block_length,length);
+        OutputIterator out=d_first+begin;
+        if(!carries[block])
+        {
+            T running=*it;
+            *out=running;
+            for(++it,++out;it!=end;++it,++out)
+            {
+                running=op(std::move(running),*it);
+                *out=running;
+            }
+            return;
+        }
+        T running=std::move(*carries[block]);
+        for(;it!=end;++it,++out)
+        {
+            if(inclusive)
+            {
+                running=op(std::move(running),*it);
+                *out=running;
+            }
+            else
+            {
+                // read before writing, for d_first==first
+                T value=*it;
+                *out=running;
+                running=op(std::move(running),std::move(value));
+            }
+        }
+    };
+    pool.run(num_blocks,pool.size(),scan_block);
+    return d_first+length;
+}
+
+template<typename Iterator,typename OutputIterator,typename BinaryOp>
+OutputIterator parallel_inclusive_scan(Iterator first,Iterator last,
+                                       OutputIterator d_first,BinaryOp op,
+                                       reduce_mode mode=reduce_mode::fast)
+{
+    typedef typename std::iterator_traits<Iterator>::value_type value_type;
+    if constexpr(!is_random_access<Iterator>() ||
+                 !is_random_access<OutputIterator>())
+    {
+        return std::inclusive_scan(first,last,d_first,op);
+    }
+    else
+    {
+        return parallel_scan_impl(first,last,d_first,
+                                  std::optional<value_type>(),op,mode,true);
+    }
+}
+
+template<typename Iterator,typename OutputIterator>
+OutputIterator parallel_inclusive_scan(Iterator first,Iterator last,
+                                       OutputIterator d_first)
+{
+    return parallel_inclusive_scan(first,last,d_first,std::plus<>());
+}
+
+template<typename Iterator,typename OutputIterator,typename T,
+         typename BinaryOp>
+OutputIterator parallel_exclusive_scan(Iterator first,Iterator last,
+                                       OutputIterator d_first,T init,
+                                       BinaryOp op,
+                                       reduce_mode mode=reduce_mode::fast)
+{
+    if constexpr(!is_random_access<Iterator>() ||
+                 !is_random_access<OutputIterator>())
+    {
+        return std::exclusive_scan(first,last,d_first,init,op);
+    }
+    else
+    {
+        return parallel_scan_impl(first,last,d_first,
+                                  std::optional<T>(std::move(init)),op,mode,
+                                  false);
+    }
+}
+
+template<typename Iterator,typename OutputIterator,typename T>
+OutputIterator parallel_exclusive_scan(Iterator first,Iterator last,
+                                       OutputIterator d_first,T init)
+{
+    return parallel_exclusive_scan(first,last,d_first,std::move(init),
+                                   std::plus<>());
+}
+
+/*
+Unsequenced execution, in the spirit of std::execution::par_unseq: the
+caller promises that f may be applied to the elements in any order and
+interleaved within a thread, so the inner loop may be vectorised.
+Over contiguous memory (pointers and the iterators of vector, array and
+string) each fork-join block becomes a raw pointer range, run as a loop
+over the pointers marked for vectorisation: omp simd when built with
+OpenMP (-fopenmp or -fopenmp-simd), GCC ivdep / clang vectorize(enable)
+otherwise, which tell the compiler the iterations are independent
+instead of leaving it to prove that. Other iterators run the sequenced
+parallel_for_each.
+With unseq_batch instead, f is called once per block with an
+element_span<T> and can run its own SIMD kernel over it. That is an
+explicit choice rather than a probe of f's signature, which would hand
+spans to any generic lambda, and it needs contiguous iterators.
+Blocks default to unseq_block_size elements, enough to amortise the
+claim and leave the vector loop a long trip count.
+*/
+#if defined(_OPENMP) || defined(UNSEQ_OPENMP_SIMD)
+#define UNSEQ_LOOP _Pragma("omp simd")
+#elif defined(__clang__)
+#define UNSEQ_LOOP _Pragma("clang loop vectorize(enable) interleave(enable)")
+#elif defined(__GNUC__)
+#define UNSEQ_LOOP _Pragma("GCC ivdep")
+#else
+#define UNSEQ_LOOP
+#endif
+
+struct unsequenced_policy
+{};
+inline constexpr unsequenced_policy unseq{};
+
+struct unsequenced_batch_policy
+{};
+inline constexpr unsequenced_batch_policy unseq_batch{};
+
+template<typename T>
+class element_span
+{
+    T* first;
+    std::size_t count;
+public:
+    element_span(T* first_,std::size_t count_):
+        first(first_),count(count_)
+    {}
+    T* data() const
+    {
+        return first;
+    }
+    std::size_t size() const
+    {
+        return count;
+    }
+    T* begin() const
+    {
+        return first;
+    }
+    T* end() const
+    {
+        return first+count;
+    }
+    T& operator[](std::size_t i) const
+    {
+        return first[i];
+    }
+};
+
+template<typename Iterator>
+struct is_contiguous_iterator
+{
+    typedef typename std::iterator_traits<Iterator>::value_type value_type;
+    static constexpr bool value=
+        std::is_pointer<Iterator>::value ||
+        (!std::is_same<value_type,bool>::value &&
+         (std::is_same<Iterator,typename std::vector<
+                                    value_type>::iterator>::value ||
+          std::is_same<Iterator,typename std::vector<
+                                    value_type>::const_iterator>::value)) ||
+        std::is_same<Iterator,typename std::basic_string<
+                                  value_type>::iterator>::value ||
+        std::is_same<Iterator,typename std::basic_string<
+                                  value_type>::const_iterator>::value;
+};
+
+unsigned long const unseq_block_size=4096;
+std::size_t const unseq_lanes=64;
+
+// runs run_block(block,count) over [data,data+length) in fork-join blocks
+template<typename T,typename Partitioner,typename RunBlock>
+void unseq_blocks(T* data,std::size_t length,Partitioner& partitioner,
+                  RunBlock run_block)
+{
+    if(!length)
+        return;
+    std::size_t const probed=partitioner.calibrate(
+        length,[&](unsigned long begin,unsigned long end){
+            run_block(data+begin,end-begin);
+            return false;
+        });
+    T* const rest=data+probed;
+    std::size_t const rest_length=length-probed;
+    if(!rest_length)
+        return;
+    fork_join_pool& pool=default_fork_join_pool();
+    unsigned long const grain=partitioner.grain_size(unseq_block_size);
+    unsigned long const num_blocks=(rest_length+grain-1)/grain;
+    auto body=[&](unsigned long block)
+    {
+        std::size_t const begin=block*grain;
+        std::size_t const count=std::min<std::size_t>(
+            grain,rest_length-begin);
+        partitioner.run_leaf([&]{
+            run_block(rest+begin,count);
+            return static_cast<unsigned long>(count);
+        });
+    };
+    pool.run(num_blocks,pool.size(),body);
+}
+
+template<typename Iterator,typename Func,typename Partitioner>
+void parallel_for_each(unsequenced_policy,Iterator first,Iterator last,
+                       Func f,Partitioner& partitioner)
+{
+    if constexpr(!is_contiguous_iterator<Iterator>::value)
+    {
+        parallel_for_each(first,last,f,partitioner,static_schedule());
+    }
+    else
+    {
+        typedef typename std::remove_reference<
+            typename std::iterator_traits<Iterator>::reference>::type T;
+        if(first==last)
+            return;
+        unseq_blocks(std::addressof(*first),std::distance(first,last),
+                     partitioner,[&f](T* block,std::size_t count)
+        {
+            // fixed-width groups: a constant trip count is what GCC's -O2
+            // cost model will vectorise without a pragma
+            std::size_t i=0;
+            for(;i+unseq_lanes<=count;i+=unseq_lanes)
+            {
+                T* const group=block+i;
+                UNSEQ_LOOP
+                for(std::size_t j=0;j<unseq_lanes;++j)
+                    f(group[j]);
+            }
+            for(;i<count;++i)
+                f(block[i]);
+        });
+    }
+}
+
+template<typename Iterator,typename Func>
+void parallel_for_each(unsequenced_policy policy,Iterator first,
+                       Iterator last,Func f)
+{
+    fixed_partitioner partitioner;
+    parallel_for_each(policy,first,last,f,partitioner);
+}
+
+template<typename Iterator,typename Func,typename Partitioner>
+void parallel_for_each(unsequenced_batch_policy,Iterator first,
+                       Iterator last,Func f,Partitioner& partitioner)
+{
+    static_assert(is_contiguous_iterator<Iterator>::value,
+                  "unseq_batch needs contiguous iterators");
+    typedef typename std::remove_reference<
+        typename std::iterator_traits<Iterator>::reference>::type T;
+    if(first==last)
+        return;
+    unseq_blocks(std::addressof(*first),std::distance(first,last),
+                 partitioner,[&f](T* block,std::size_t count)
+    {
+        f(element_span<T>(block,count));
+    });
+}
+
+template<typename Iterator,typename Func>
+void parallel_for_each(unsequenced_batch_policy policy,Iterator first,
+                       Iterator last,Func f)
+{
+    fixed_partitioner partitioner;
+    parallel_for_each(policy,first,last,f,partitioner);
+}
+
+/*
+Multi-dimensional loops over row-major data. A blocked range names the
+index box to cover, and the body is called once per tile, a sub-box it
+loops over itself, so its inner loop stays a plain contiguous loop.
+Tile shapes come from the cache sizes (sysconf where glibc has them, 48
+KiB L1 and 2 MiB L2 otherwise): l1_tile_2d makes a square whose cells, in
+each of the arrays the body touches, fit in L1 together; l2_tile_3d makes
+a cube that fits in L2 the same way, or, given the row length, a tile of
+whole rows: long contiguous inner loops are what the prefetcher wants, and
+a stencil over rows only needs its neighbouring rows and pages in cache.
+Sides are rounded down to whole cache lines.
+Tiles go to the fork_join_pool in runs of consecutive tiles, a few runs
+per thread. In row-major tile order a run is a strip; in Morton
+(Z-curve) order, which interleaves the bits of the tile coordinates, it is
+a compact square-ish (cubic-ish) patch, so tiles that share edges, and
+the cache lines along them, mostly run on the same core.
+*/
+struct blocked_range_2d
+{
+    std::size_t row_begin,row_end;
+    std::size_t col_begin,col_end;
+};
+
+struct blocked_range_3d
+{
+    std::size_t page_begin,page_end;
+    std::size_t row_begin,row_end;
+    std::size_t col_begin,col_end;
+};
+
+struct tile_2d
+{
+    std::size_t rows,cols;
+};
+
+struct tile_3d
+{
+    std::size_t pages,rows,cols;
+};
+
+enum class tile_order
+{
+    row_major,
+    morton
+};
+
+inline std::size_t cache_size(int level)
+{
+    long size=-1;
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    size=::sysconf(level==1?_SC_LEVEL1_DCACHE_SIZE:_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if(size<=0)
+        return level==1?48*1024:2*1024*1024;
+    return static_cast<std::size_t>(size);
+}
+
+inline std::size_t round_to_cache_lines(std::size_t side,
+                                        std::size_t bytes_per_cell)
+{
+    std::size_t const line_cells=std::max<std::size_t>(64/bytes_per_cell,1);
+    return side>=line_cells?side/line_cells*line_cells:std::max<std::size_t>(
+        side,1);
+}
+
+inline tile_2d l1_tile_2d(std::size_t bytes_per_cell,unsigned arrays=2)
+{
+    std::size_t const cells=cache_size(1)/(arrays*bytes_per_cell);
+    std::size_t const side=round_to_cache_lines(
+        static_cast<std::size_t>(std::sqrt(static_cast<double>(cells))),
+        bytes_per_cell);
+    return tile_2d{side,side};
+}
+
+// with row_length, tiles keep whole rows and only pages and rows are cut
+inline tile_3d l2_tile_3d(std::size_t bytes_per_cell,unsigned arrays=2,
+                          std::size_t row_length=0)
+{
+    std::size_t const cells=cache_size(2)/(arrays*bytes_per_cell);
+    if(row_length)
+    {
+        std::size_t const side=std::max<std::size_t>(static_cast<std::size_t>(
+            std::sqrt(static_cast<double>(cells/row_length))),1);
+        return tile_3d{side,side,row_length};
+    }
+    std::size_t const side=round_to_cache_lines(
+        static_cast<std::size_t>(std::cbrt(static_cast<double>(cells))),
+        bytes_per_cell);
+    return tile_3d{side,side,side};
+}
+
+// spreads the low 21 bits of x to every third bit
+inline std::uint64_t spread_bits_3(std::uint64_t x)
+{
+    x&=0x1fffff;
+    x=(x|x<<32)&0x1f00000000ffffull;
+    x=(x|x<<16)&0x1f0000ff0000ffull;
+    x=(x|x<<8)&0x100f00f00f00f00full;
+    x=(x|x<<4)&0x10c30c30c30c30c3ull;
+    x=(x|x<<2)&0x1249249249249249ull;
+    return x;
+}
+
+inline std::uint64_t compact_bits_3(std::uint64_t x)
+{
+    x&=0x1249249249249249ull;
+    x=(x|x>>2)&0x10c30c30c30c30c3ull;
+    x=(x|x>>4)&0x100f00f00f00f00full;
+    x=(x|x>>8)&0x1f0000ff0000ffull;
+    x=(x|x>>16)&0x1f00000000ffffull;
+    x=(x|x>>32)&0x1fffff;
+    return x;
+}
+
+// visit(page,row,col) for every tile of a pages x rows x cols tile grid
+template<typename Visit>
+void for_each_tile(std::size_t pages,std::size_t rows,std::size_t cols,
+                   tile_order order,Visit visit)
+{
+    std::size_t const num_tiles=pages*rows*cols;
+    if(!num_tiles)
+        return;
+    std::vector<std::uint64_t> morton;
+    if(order==tile_order::morton)
+    {
+        if(std::max({pages,rows,cols})>(std::size_t(1)<<21))
+            throw std::length_error("for_each_tile: tile grid too large");
+        morton.reserve(num_tiles);
+        for(std::size_t p=0;p<pages;++p)
+            for(std::size_t r=0;r<rows;++r)
+                for(std::size_t c=0;c<cols;++c)
+                    morton.push_back(spread_bits_3(p)<<2 |
+                                     spread_bits_3(r)<<1 |
+                                     spread_bits_3(c));
+        std::sort(morton.begin(),morton.end());
+    }
+
+    fork_join_pool& pool=default_fork_join_pool();
+    unsigned long const num_runs=
+        std::min<unsigned long>(num_tiles,4ul*pool.size());
+    auto body=[&](unsigned long run)
+    {
+        std::size_t const begin=num_tiles*run/num_runs;
+        std::size_t const end=num_tiles*(run+1)/num_runs;
+        for(std::size_t t=begin;t<end;++t)
+        {
+            if(order==tile_order::morton)
+                visit(compact_bits_3(morton[t]>>2),
+                      compact_bits_3(morton[t]>>1),
+                      compact_bits_3(morton[t]));
+            else
+                visit(t/(rows*cols),t/cols%rows,t%cols);
+        }
+    };
+    pool.run(num_runs,pool.size(),body);
+}
+
+inline std::size_t tiles_along(std::size_t begin,std::size_t end,
+                               std::size_t tile)
+{
+    return end>begin?(end-begin+tile-1)/tile:0;
+}
+
+template<typename Func>
+void parallel_for_2d(blocked_range_2d const& range,tile_2d tile,Func f,
+                     tile_order order=tile_order::morton)
+{
+    if(!tile.rows || !tile.cols)
+        throw std::invalid_argument("parallel_for_2d: empty tile");
+    for_each_tile(
+        1,tiles_along(range.row_begin,range.row_end,tile.rows),
+        tiles_along(range.col_begin,range.col_end,tile.cols),order,
+        [&](std::size_t,std::size_t r,std::size_t c)
+        {
+            std::size_t const row=range.row_begin+r*tile.rows;
+            std::size_t const col=range.col_begin+c*tile.cols;
+            f(blocked_range_2d{
+                row,std::min(row+tile.rows,range.row_end),
+                col,std::min(col+tile.cols,range.col_end)});
+        });
+}
+
+template<typename Func>
+void parallel_for_3d(blocked_range_3d const& range,tile_3d tile,Func f,
+                     tile_order order=tile_order::morton)
+{
+    if(!tile.pages || !tile.rows || !tile.cols)
+        throw std::invalid_argument("parallel_for_3d: empty tile");
+    for_each_tile(
+        tiles_along(range.page_begin,range.page_end,tile.pages),
+        tiles_along(range.row_begin,range.row_end,tile.rows),
+        tiles_along(range.col_begin,range.col_end,tile.cols),order,
+        [&](std::size_t p,std::size_t r,std::size_t c)
+        {
+            std::size_t const page=range.page_begin+p*tile.pages;
+            std::size_t const row=range.row_begin+r*tile.rows;
+            std::size_t const col=range.col_begin+c*tile.cols;
+            f(blocked_range_3d{
+                page,std::min(page+tile.pages,range.page_end),
+                row,std::min(row+tile.rows,range.row_end),
+                col,std::min(col+tile.cols,range.col_end)});
+        });
+}
+
+void benchmark_parallel_foreach()
+{
+  unsigned long const size=1000000;
+  unsigned const repeats=3;
+  std::vector<double> vec(size);
+  auto const work=[](double& x){x=std::sqrt(x+1.0);};
+
+  auto start=std::chrono::high_resolution_clock::now();
+  for(unsigned r=0;r<repeats;++r)
+    parallel_for_each_async(vec.begin(),vec.end(),work);
+  auto stop=std::chrono::high_resolution_clock::now();
+  double const async_seconds=
+    std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+  std::cout<<"std::async for_each: "<<size*repeats/async_seconds/1e6
+  <<" Melem/s"<<std::endl;
+
+  unsigned const hardware_threads=
+    std::max(std::thread::hardware_concurrency(),1u);
+  for(unsigned cores=1;cores<=hardware_threads;++cores)
+  {
+    thread_pool pool(cores);
+    start=std::chrono::high_resolution_clock::now();
+    for(unsigned r=0;r<repeats;++r)
+      parallel_for_each_pooled(pool,vec.begin(),vec.end(),work);
+    stop=std::chrono::high_resolution_clock::now();
+    double const pool_seconds=
+      std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+    std::cout<<"pool for_each, "<<cores<<" cores: "
+    <<size*repeats/pool_seconds/1e6<<" Melem/s"<<std::endl;
+  }
+}
+
+// a std::list, where the old parallel_for_each walked the whole list
+// with std::distance and std::advance before starting any thread
+void benchmark_forward_for_each()
+{
+  unsigned long const size=1000000;
+  std::list<double> values(size);
+  auto const work=[](double& x){x=std::sqrt(x+1.0);};
+
+  auto start=std::chrono::high_resolution_clock::now();
+  std::for_each(values.begin(),values.end(),work);
+  auto stop=std::chrono::high_resolution_clock::now();
+  double const std_seconds=
+    std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+
+  start=std::chrono::high_resolution_clock::now();
+  parallel_for_each(values.begin(),values.end(),work);
+  stop=std::chrono::high_resolution_clock::now();
+  double const forward_seconds=
+    std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+  std::cout<<"list for_each: std "<<size/std_seconds/1e6
+  <<" Melem/s, forward walker "<<size/forward_seconds/1e6
+  <<" Melem/s"<<std::endl;
+}
+
+// the same loop with a cheap and an expensive body: the fixed grain of 25
+// is far too fine for the first, auto_partitioner adapts to both
+void benchmark_partitioner()
+{
+  unsigned long const size=1000000;
+  std::vector<double> vec(size);
+  auto const cheap=[](double& x){x=std::sqrt(x+1.0);};
+  auto const expensive=[](double& x){
+    for(int i=0;i<200;++i)
+      x=std::sqrt(x+1.0);
+  };
+
+  auto const seconds=[&](auto run)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    run();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+  };
+
+  fixed_partitioner fixed;
+  auto_partitioner cheap_auto,expensive_auto;
+  std::cout<<"async for_each, cheap body: fixed grain "
+  <<size/seconds([&]{
+      parallel_for_each_async(vec.begin(),vec.end(),cheap,fixed);})/1e6
+  <<" Melem/s, auto "
+  <<size/seconds([&]{
+      parallel_for_each_async(vec.begin(),vec.end(),cheap,cheap_auto);})/1e6
+  <<" Melem/s (grain "<<cheap_auto.grain_size(0)<<")"<<std::endl;
+  unsigned long const expensive_size=size/20;
+  std::cout<<"async for_each, expensive body: fixed grain "
+  <<expensive_size/seconds([&]{
+      parallel_for_each_async(vec.begin(),vec.begin()+expensive_size,
+                              expensive,fixed);})/1e6
+  <<" Melem/s, auto "
+  <<expensive_size/seconds([&]{
+      parallel_for_each_async(vec.begin(),vec.begin()+expensive_size,
+                              expensive,expensive_auto);})/1e6
+  <<" Melem/s (grain "<<expensive_auto.grain_size(0)<<")"<<std::endl;
+}
+
+// per-call cost of a trivial loop: a thread and a future per block, as
+// parallel_for_each used to start, against the persistent fork-join pool
+void benchmark_fork_join_overhead()
+{
+  for(unsigned long const size:{1000ul,10000ul,1000000ul})
+  {
+    std::vector<int> vec(size);
+    auto const work=[](int& x){++x;};
+    unsigned long const calls=size<1000000?2000:20;
+
+    auto start=std::chrono::high_resolution_clock::now();
+    for(unsigned long c=0;c<calls;++c)
+      parallel_for_each_spawning(vec.begin(),vec.end(),work);
+    auto stop=std::chrono::high_resolution_clock::now();
+    double const thread_us=
+      std::chrono::duration<double,std::micro>(stop-start).count()/calls;
+
+    start=std::chrono::high_resolution_clock::now();
+    for(unsigned long c=0;c<calls;++c)
+      parallel_for_each(vec.begin(),vec.end(),work);
+    stop=std::chrono::high_resolution_clock::now();
+    double const pool_us=
+      std::chrono::duration<double,std::micro>(stop-start).count()/calls;
+
+    std::cout<<size<<" elements per call: thread per block "<<thread_us
+    <<" us, parallel_for_each (fork-join pool) "<<pool_us<<" us"
+    <<std::endl;
+  }
+}
+
+// skewed loops: with static blocks the thread holding the expensive end
+// of a triangular loop finishes long after the rest; dynamic and guided
+// claim chunks as threads free up. "vs ideal" is the wall time against
+// the serial time divided by the thread count.
+void benchmark_schedules()
+{
+  unsigned long const size=20000;
+  std::vector<unsigned> triangular(size),random_cost(size);
+  std::mt19937 rng(11);
+  std::exponential_distribution<double> cost(1.0/400);
+  for(unsigned long i=0;i<size;++i)
+  {
+    triangular[i]=static_cast<unsigned>(800*i/size);
+    random_cost[i]=static_cast<unsigned>(cost(rng));
+  }
+  std::vector<double> out(size);
+  auto const spin=[](unsigned n)
+  {
+    double x=1.0;
+    for(unsigned i=0;i<n;++i)
+      x=std::sqrt(x+1.0);
+    return x;
+  };
+  unsigned const threads=std::max(std::thread::hardware_concurrency(),1u);
+
+  for(auto const* costs:{&triangular,&random_cost})
+  {
+    std::vector<unsigned> indices(size);
+    std::iota(indices.begin(),indices.end(),0u);
+    auto const body=[&](unsigned i){out[i]=spin((*costs)[i]);};
+
+    auto const seconds=[&](auto run)
+    {
+      auto const start=std::chrono::high_resolution_clock::now();
+      run();
+      auto const stop=std::chrono::high_resolution_clock::now();
+      return std::chrono::duration<double,std::milli>(stop-start).count();
+    };
+    double const serial=seconds([&]{
+      std::for_each(indices.begin(),indices.end(),body);});
+    double const ideal=serial/threads;
+    double const fixed=seconds([&]{
+      parallel_for_each(indices.begin(),indices.end(),body,
+                        static_schedule());});
+    double const dynamic=seconds([&]{
+      parallel_for_each(indices.begin(),indices.end(),body,
+                        dynamic_schedule(64));});
+    double const guided=seconds([&]{
+      parallel_for_each(indices.begin(),indices.end(),body,
+                        guided_schedule(16));});
+    std::cout<<(costs==&triangular?"triangular":"random")
+    <<" cost, "<<threads<<" threads: static "<<fixed<<" ms ("
+    <<fixed/ideal<<"x ideal), dynamic "<<dynamic<<" ms ("
+    <<dynamic/ideal<<"x), guided "<<guided<<" ms ("<<guided/ideal
+    <<"x)"<<std::endl;
+  }
+}
+
+// a float matrix transpose and a 7-point 3D stencil: tiled, in row-major
+// and Morton tile order, against a naive split over rows (pages)
+void benchmark_tiled_loops()
+{
+  auto const ms=[](auto run)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    run();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::milli>(stop-start).count();
+  };
+
+  std::size_t const n=4096;
+  std::vector<float> a(n*n),b(n*n);
+  std::iota(a.begin(),a.end(),0.0f);
+  std::vector<std::size_t> rows(n);
+  std::iota(rows.begin(),rows.end(),std::size_t(0));
+  auto const transpose_tile=[&](blocked_range_2d const& t)
+  {
+    for(std::size_t i=t.row_begin;i<t.row_end;++i)
+      for(std::size_t j=t.col_begin;j<t.col_end;++j)
+        b[j*n+i]=a[i*n+j];
+  };
+  tile_2d const tile2=l1_tile_2d(sizeof(float));
+  double const naive_transpose=ms([&]{
+    parallel_for_each(rows.begin(),rows.end(),[&](std::size_t i){
+      for(std::size_t j=0;j<n;++j)
+        b[j*n+i]=a[i*n+j];
+    });});
+  double const row_major_transpose=ms([&]{
+    parallel_for_2d({0,n,0,n},tile2,transpose_tile,tile_order::row_major);});
+  double const morton_transpose=ms([&]{
+    parallel_for_2d({0,n,0,n},tile2,transpose_tile,tile_order::morton);});
+  bool const transposed=b[5*n+7]==a[7*n+5];
+  std::cout<<"transpose "<<n<<"x"<<n<<" ("<<tile2.rows<<"x"<<tile2.cols
+  <<" tiles): row split "<<naive_transpose<<" ms, tiled "
+  <<row_major_transpose<<" ms, tiled morton "<<morton_transpose<<" ms"
+  <<(transposed?"":" (WRONG RESULT)")<<std::endl;
+
+  std::size_t const m=192;
+  std::vector<float> in(m*m*m,1.0f),out(m*m*m,0.0f);
+  std::vector<std::size_t> pages(m-2);
+  std::iota(pages.begin(),pages.end(),std::size_t(1));
+  auto const at=[m](std::size_t p,std::size_t r,std::size_t c)
+  {
+    return (p*m+r)*m+c;
+  };
+  auto const stencil_row=[&](std::size_t p,std::size_t r,
+                             std::size_t c0,std::size_t c1)
+  {
+    for(std::size_t c=c0;c<c1;++c)
+      out[at(p,r,c)]=0.4f*in[at(p,r,c)]+0.1f*(
+        in[at(p-1,r,c)]+in[at(p+1,r,c)]+in[at(p,r-1,c)]+
+        in[at(p,r+1,c)]+in[at(p,r,c-1)]+in[at(p,r,c+1)]);
+  };
+  auto const stencil_tile=[&](blocked_range_3d const& t)
+  {
+    for(std::size_t p=t.page_begin;p<t.page_end;++p)
+      for(std::size_t r=t.row_begin;r<t.row_end;++r)
+        stencil_row(p,r,t.col_begin,t.col_end);
+  };
+  tile_3d const tile3=l2_tile_3d(sizeof(float),2,m-2);
+  blocked_range_3d const interior{1,m-1,1,m-1,1,m-1};
+  double const naive_stencil=ms([&]{
+    parallel_for_each(pages.begin(),pages.end(),[&](std::size_t p){
+      for(std::size_t r=1;r<m-1;++r)
+        stencil_row(p,r,1,m-1);
+    });});
+  double const row_major_stencil=ms([&]{
+    parallel_for_3d(interior,tile3,stencil_tile,tile_order::row_major);});
+  double const morton_stencil=ms([&]{
+    parallel_for_3d(interior,tile3,stencil_tile,tile_order::morton);});
+  std::cout<<"7-point stencil "<<m<<"^3 ("<<tile3.pages<<"x"<<tile3.rows
+  <<"x"<<tile3.cols<<" tiles): "
+  <<"page split "<<naive_stencil<<" ms, tiled "<<row_major_stencil
+  <<" ms, tiled morton "<<morton_stencil<<" ms"
+  <<(out[at(m/2,m/2,m/2)]==1.0f?"":" (WRONG RESULT)")<<std::endl;
+}
+
+// a saxpy-style update of floats small enough to stay in L2, so the loop
+// and not memory bandwidth sets the pace: the sequenced loop, the
+// unsequenced element loop and a batch functor over element_span
+void benchmark_unseq()
+{
+  std::size_t const size=std::size_t(1)<<16;
+  unsigned const repeats=5000;
+  std::vector<float> values(size,1.0f);
+  float const a=0.999f,b=0.001f;
+  auto const element=[a,b](float& x){x=a*x+b;};
+  auto const batch=[a,b](element_span<float> s)
+  {
+    float* const p=s.data();
+    std::size_t const n=s.size();
+    for(std::size_t i=0;i<n;++i)
+      p[i]=a*p[i]+b;
+  };
+
+  auto const gbs=[&](auto run)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    for(unsigned r=0;r<repeats;++r)
+      run();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    double const seconds=
+      std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+    return 2.0*sizeof(float)*size*repeats/seconds/1e9;
+  };
+  std::cout<<"float a*x+b GB/s: parallel_for_each "
+  <<gbs([&]{parallel_for_each(values.begin(),values.end(),element);})
+  <<", unseq "
+  <<gbs([&]{parallel_for_each(unseq,values.begin(),values.end(),element);})
+  <<", unseq batch "
+  <<gbs([&]{
+      parallel_for_each(unseq_batch,values.begin(),values.end(),batch);})
+  <<std::endl;
+}
+
+void benchmark_reduce_scan()
+{
+  std::size_t const size=std::size_t(1)<<24;
+  std::vector<double> values(size);
+  std::mt19937_64 rng(7);
+  std::uniform_real_distribution<double> dist(0.0,1.0);
+  for(auto& v:values)
+    v=dist(rng);
+  std::vector<double> scanned(size),expected(size);
+
+  auto const time_ms=[](auto run)
+  {
+    auto const start=std::chrono::high_resolution_clock::now();
+    run();
+    auto const stop=std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::milli>(stop-start).count();
+  };
+  double serial=0,fast=0,fixed=0;
+  double const t_serial=time_ms([&]
+  {serial=std::accumulate(values.begin(),values.end(),0.0);});
+  double const t_fast=time_ms([&]
+  {fast=parallel_reduce(values.begin(),values.end(),0.0,std::plus<>());});
+  double const t_fixed=time_ms([&]
+  {
+    fixed=parallel_reduce(values.begin(),values.end(),0.0,std::plus<>(),
+                          reduce_mode::deterministic);
+  });
+  std::cout<<"sum: std::accumulate "<<t_serial<<" ms, parallel_reduce "
+  <<t_fast<<" ms, deterministic "<<t_fixed<<" ms"<<std::endl;
+  std::cout.precision(17);
+  std::cout<<"  values "<<serial<<", "<<fast<<", "<<fixed<<std::endl;
+  std::cout.precision(6);
+
+  double squares=0,parallel_squares=0;
+  double const t_inner=time_ms([&]
+  {
+    squares=std::inner_product(values.begin(),values.end(),values.begin(),
+                               0.0);
+  });
+  double const t_transform=time_ms([&]
+  {
+    parallel_squares=parallel_transform_reduce(
+      values.begin(),values.end(),0.0,std::plus<>(),
+      [](double v){return v*v;});
+  });
+  std::cout<<"sum of squares: std::inner_product "<<t_inner
+  <<" ms, parallel_transform_reduce "<<t_transform<<" ms, relative error "
+  <<std::abs(parallel_squares-squares)/squares<<std::endl;
+
+  double const t_partial=time_ms([&]
+  {std::partial_sum(values.begin(),values.end(),expected.begin());});
+  double const t_scan=time_ms([&]
+  {parallel_inclusive_scan(values.begin(),values.end(),scanned.begin());});
+  double worst=0;
+  for(std::size_t i=0;i<size;++i)
+    worst=std::max(worst,std::abs(scanned[i]-expected[i])/expected[i]);
+  double const t_exclusive=time_ms([&]
+  {
+    parallel_exclusive_scan(values.begin(),values.end(),scanned.begin(),
+                            0.0,std::plus<>(),reduce_mode::deterministic);
   });
+  bool const shifted=scanned[0]==0.0 && scanned[1]==values[0];
+  std::cout<<"prefix sum: std::partial_sum "<<t_partial
+  <<" ms, parallel_inclusive_scan "<<t_scan
+  <<" ms (worst relative error "<<worst
+  <<"), deterministic parallel_exclusive_scan "<<t_exclusive<<" ms"
+  <<(shifted?"":" WRONG")<<std::endl;
 }
 
 int main()
@@ -214,6 +2263,14 @@ int main()
   // std::cout << std::hardware_constructive_interference_size << std::endl;
   parallel_foreach();
   // parallel_foreach_async();
+  benchmark_parallel_foreach();
+  benchmark_forward_for_each();
+  benchmark_partitioner();
+  benchmark_fork_join_overhead();
+  benchmark_schedules();
+  benchmark_tiled_loops();
+  benchmark_unseq();
+  benchmark_reduce_scan();
 
   
    //specifies the maximum number of consecutive bytes that may be subject 
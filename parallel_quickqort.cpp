@@ -6,7 +6,36 @@
 #include <stack>
 #include <algorithm>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <random>
+#include <mutex>
+#include <iterator>
+#include <span>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <barrier>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <array>
+#include <cstdlib>
+#include <new>
+#include <cstdio>
+#include <filesystem>
+#include <condition_variable>
+#include <deque>
+#include <cmath>
+#include <unistd.h>
 // TODO: need boost::shared_ptr to make it right
+// g++ -std=c++20 -pthread parallel_quickqort.cpp -latomic
+// (atomic::wait needs C++20, the 16-byte counted_node_ptr needs libatomic)
 using namespace std;
 
 template<typename T>
@@ -24,8 +53,8 @@ private:
         std::shared_ptr<T> data;
         std::atomic<int> internal_count;
         counted_node_ptr next;
-        node(T const& data_):
-            data(std::make_shared<T>(data_)),
+        node(T&& data_):
+            data(std::make_shared<T>(std::move(data_))),
             internal_count(0)
         {}
     };
@@ -49,10 +78,11 @@ public:
     {
         while(pop());
     }
-    void push(T const& data)
+    // by value, so move-only types can be pushed
+    void push(T data)
     {
         counted_node_ptr new_node;
-        new_node.ptr=new node(data);
+        new_node.ptr=new node(std::move(data));
         new_node.external_count=1;
         new_node.ptr->next=head.load(std::memory_order_relaxed);
             while(!head.compare_exchange_weak(
@@ -95,119 +125,3038 @@ public:
     }
 };
 
+/*
+Pivot selection. The first element as pivot makes sorted and reversed
+input quadratic, with one chunk per element. The pivot is the median of
+three samples, or Tukey's ninther from 128 elements up. On top of that a
+range still being split after introsort_depth_limit levels falls back to
+an O(n log n) sort (std::list::sort for lists, heap sort for ranges).
+*/
+std::size_t const ninther_threshold=128;
+
+inline unsigned introsort_depth_limit(std::size_t size)
+{
+    unsigned depth=0;
+    for(;size>1;size>>=1)
+        ++depth;
+    return 2*depth;
+}
+
+template<typename Iterator>
+Iterator median_of_three(Iterator a,Iterator b,Iterator c)
+{
+    if(*b<*a) std::swap(a,b);
+    if(*c<*b) std::swap(b,c);
+    if(*b<*a) std::swap(a,b);
+    return b;
+}
+
+// one walk over the list to reach the samples
+template<typename T>
+typename std::list<T>::iterator choose_pivot(std::list<T>& data)
+{
+    std::size_t const size=data.size();
+    if(size<3)
+    {
+        return data.begin();
+    }
+    std::size_t const samples=size<ninther_threshold?3:9;
+    typename std::list<T>::iterator sample[9];
+    auto it=data.begin();
+    std::size_t pos=0;
+    for(std::size_t i=0;i<samples;++i)
+    {
+        std::size_t const target=i*(size-1)/(samples-1);
+        std::advance(it,target-pos);
+        pos=target;
+        sample[i]=it;
+    }
+    if(samples==3)
+    {
+        return median_of_three(sample[0],sample[1],sample[2]);
+    }
+    return median_of_three(median_of_three(sample[0],sample[1],sample[2]),
+                           median_of_three(sample[3],sample[4],sample[5]),
+                           median_of_three(sample[6],sample[7],sample[8]));
+}
+
+/*
+Contiguous ranges: the list sorts pay a heap node per element and chase
+pointers in every partition, so vectors and spans get their own path.
+partition_range is a block partition (Edelkamp and Weiss, BlockQuicksort):
+it first records the offsets of misplaced elements of a 64-element block
+from each end without branching on the comparison, then swaps them in
+pairs. It returns the final position of the pivot, with [first,pivot)
+less than it and (pivot,last) not less than it.
+*/
+std::ptrdiff_t const range_insertion_sort_threshold=24;
+std::ptrdiff_t const range_partition_block_size=64;
+
+template<typename T>
+void insertion_sort_range(T* first,T* last)
+{
+    if(first==last)
+        return;
+    for(T* i=first+1;i<last;++i)
+    {
+        T value=std::move(*i);
+        T* j=i;
+        for(;j>first && value<*(j-1);--j)
+        {
+            *j=std::move(*(j-1));
+        }
+        *j=std::move(value);
+    }
+}
+
+template<typename T>
+void sort3(T* a,T* b,T* c)
+{
+    if(*b<*a) std::iter_swap(a,b);
+    if(*c<*b) std::iter_swap(b,c);
+    if(*b<*a) std::iter_swap(a,b);
+}
+
+/*
+Leaf kernel for partitions of up to 16 elements. The comparator lists are
+Batcher's odd-even merge sort networks, generated by constexpr functions
+at compile time (for n not a power of two, the comparators that touch a
+position past n are dropped, as if those were +infinity), and each
+network is unrolled through an index_sequence so every compare-exchange
+works on fixed positions held in registers. The compare-exchange has no
+branch: integers compile to cmov, floating point to minss/maxss (or
+minsd/maxsd). Like the comparison sorts, this needs a strict weak order,
+so no NaN; with one the leaf could duplicate a value. Only arithmetic
+types get networks; for the rest a swap costs more than the branch it
+saves, so they keep insertion sort.
+*/
+std::size_t const max_network_size=16;
+
+struct network_comparator
+{
+    unsigned char i;
+    unsigned char j;
+};
+
+template<typename Emit>
+constexpr void batcher_network(std::size_t n,Emit emit)
+{
+    std::size_t p2=1;
+    while(p2<n)
+        p2*=2;
+    for(std::size_t p=1;p<p2;p*=2)
+        for(std::size_t k=p;k>0;k/=2)
+            for(std::size_t j=k%p;j+k<p2;j+=2*k)
+                for(std::size_t i=0;i<k;++i)
+                    if((i+j)/(2*p)==(i+j+k)/(2*p) && i+j+k<n)
+                        emit(i+j,i+j+k);
+}
+
+template<std::size_t N>
+constexpr std::size_t network_length()
+{
+    std::size_t length=0;
+    batcher_network(N,[&](std::size_t,std::size_t){++length;});
+    return length;
+}
+
+template<std::size_t N>
+constexpr std::array<network_comparator,network_length<N>()> make_network()
+{
+    std::array<network_comparator,network_length<N>()> network{};
+    std::size_t pos=0;
+    batcher_network(N,[&](std::size_t i,std::size_t j){
+        network[pos++]=network_comparator{static_cast<unsigned char>(i),
+                                          static_cast<unsigned char>(j)};
+    });
+    return network;
+}
+
+template<std::size_t N>
+inline constexpr auto sorting_network=make_network<N>();
+
+template<typename T>
+void compare_exchange(T& a,T& b)
+{
+    if constexpr(std::is_integral<T>::value)
+    {
+        // hi from the xor keeps gcc from turning the pair into a branch
+        T const lo=b<a?b:a;
+        T const hi=a^b^lo;
+        a=lo;
+        b=hi;
+    }
+    else
+    {
+        // both outputs from one comparison: with std::min and std::max
+        // equal values (+0.0 and -0.0) would both come out as a
+        bool const swap=b<a;
+        T const lo=swap?b:a;
+        T const hi=swap?a:b;
+        a=lo;
+        b=hi;
+    }
+}
+
+template<std::size_t N,typename T,std::size_t... I>
+void apply_network([[maybe_unused]] T* a,std::index_sequence<I...>)
+{
+    (compare_exchange(a[sorting_network<N>[I].i],a[sorting_network<N>[I].j]),
+     ...);
+}
+
+// the values are loaded into locals so the whole network runs in registers
+template<std::size_t N,typename T>
+void network_sort(T* a)
+{
+    T v[N>0?N:1];
+    std::copy(a,a+N,v);
+    apply_network<N>(v,std::make_index_sequence<sorting_network<N>.size()>());
+    std::copy(v,v+N,a);
+}
+
+template<typename T,std::size_t... N>
+void network_sort_dispatch(T* first,std::size_t size,
+                           std::index_sequence<N...>)
+{
+    static constexpr void (*table[])(T*)={&network_sort<N,T>...};
+    table[size](first);
+}
+
+// partitions at or below leaf_size<T> go to small_sort_range
+template<typename T>
+constexpr std::ptrdiff_t leaf_size=std::is_arithmetic<T>::value?
+    static_cast<std::ptrdiff_t>(max_network_size):
+    range_insertion_sort_threshold;
+
+template<typename T>
+void small_sort_range(T* first,T* last)
+{
+    if constexpr(std::is_arithmetic<T>::value)
+    {
+        if(last-first<=static_cast<std::ptrdiff_t>(max_network_size))
+        {
+            network_sort_dispatch(
+                first,static_cast<std::size_t>(last-first),
+                std::make_index_sequence<max_network_size+1>());
+            return;
+        }
+    }
+    insertion_sort_range(first,last);
+}
+
+// lists that small are sorted in place, without a chunk or a future
+template<typename T>
+void small_sort_list(std::list<T>& data)
+{
+    if constexpr(std::is_arithmetic<T>::value)
+    {
+        T values[max_network_size];
+        T* last=std::copy(data.begin(),data.end(),values);
+        small_sort_range(values,last);
+        std::copy(values,last,data.begin());
+    }
+    else
+    {
+        data.sort();
+    }
+}
+
+/*
+Moves the pivot to *begin and leaves an element not less than it at
+end[-1] (or mid[1] for the ninther), which stops the first scan of
+partition_range. Returns true if a neighbouring sample equals the pivot,
+the cheap hint that the range is duplicate-heavy.
+Needs end-begin>=3.
+*/
+template<typename T>
+bool move_pivot_to_front(T* const begin,T* const end)
+{
+    std::ptrdiff_t const size=end-begin;
+    T* const mid=begin+size/2;
+    sort3(begin,mid,end-1);
+    bool equal_sample;
+    if(size>=static_cast<std::ptrdiff_t>(ninther_threshold))
+    {
+        sort3(begin+1,mid-1,end-2);
+        sort3(begin+2,mid+1,end-3);
+        sort3(mid-1,mid,mid+1);
+        equal_sample=!(*(mid-1)<*mid) || !(*mid<*(mid+1));
+    }
+    else
+    {
+        equal_sample=!(*begin<*mid) || !(*mid<*(end-1));
+    }
+    std::iter_swap(begin,mid);
+    return equal_sample;
+}
+
+// pivot already at *begin
+template<typename T>
+T* partition_range(T* const begin,T* const end)
+{
+    std::ptrdiff_t const B=range_partition_block_size;
+    T pivot=std::move(*begin);
+
+    T* first=begin;
+    T* last=end;
+    while(*++first<pivot);
+    if(first-1==begin)
+    {
+        while(first<last && !(*--last<pivot));
+    }
+    else
+    {
+        while(!(*--last<pivot));
+    }
+    if(first<last)
+    {
+        std::iter_swap(first,last);
+        ++first;
+    }
+
+    unsigned char offsets_l[B];
+    unsigned char offsets_r[B];
+    std::ptrdiff_t num_l=0,num_r=0,start_l=0,start_r=0;
+    auto const swap_offsets=[&](std::ptrdiff_t num)
+    {
+        for(std::ptrdiff_t i=0;i<num;++i)
+        {
+            std::iter_swap(first+offsets_l[start_l+i],
+                           last-offsets_r[start_r+i]);
+        }
+        num_l-=num;
+        num_r-=num;
+        start_l+=num;
+        start_r+=num;
+    };
+    auto const fill_left=[&](std::ptrdiff_t size)
+    {
+        start_l=0;
+        T* it=first;
+        for(std::ptrdiff_t i=0;i<size;++it)
+        {
+            offsets_l[num_l]=static_cast<unsigned char>(i++);
+            num_l+=!(*it<pivot);
+        }
+    };
+    auto const fill_right=[&](std::ptrdiff_t size)
+    {
+        start_r=0;
+        T* it=last;
+        for(std::ptrdiff_t i=0;i<size;)
+        {
+            offsets_r[num_r]=static_cast<unsigned char>(++i);
+            num_r+=*--it<pivot;
+        }
+    };
+
+    while(last-first>2*B)
+    {
+        if(!num_l)
+            fill_left(B);
+        if(!num_r)
+            fill_right(B);
+        swap_offsets(std::min(num_l,num_r));
+        if(!num_l)
+            first+=B;
+        if(!num_r)
+            last-=B;
+    }
+
+    std::ptrdiff_t l_size=0,r_size=0;
+    std::ptrdiff_t const unknown=(last-first)-((num_l || num_r)?B:0);
+    if(num_r)
+    {
+        l_size=unknown;
+        r_size=B;
+    }
+    else if(num_l)
+    {
+        l_size=B;
+        r_size=unknown;
+    }
+    else
+    {
+        l_size=unknown/2;
+        r_size=unknown-l_size;
+    }
+    if(unknown && !num_l)
+        fill_left(l_size);
+    if(unknown && !num_r)
+        fill_right(r_size);
+    swap_offsets(std::min(num_l,num_r));
+    if(!num_l)
+        first+=l_size;
+    if(!num_r)
+        last-=r_size;
+
+    if(num_l)
+    {
+        while(num_l--)
+        {
+            std::iter_swap(first+offsets_l[start_l+num_l],--last);
+        }
+        first=last;
+    }
+    if(num_r)
+    {
+        while(num_r--)
+        {
+            std::iter_swap(last-offsets_r[start_r+num_r],first);
+            ++first;
+        }
+        last=first;
+    }
+
+    T* const pivot_pos=first-1;
+    *begin=std::move(*pivot_pos);
+    *pivot_pos=std::move(pivot);
+    return pivot_pos;
+}
+
+/*
+Dutch national flag partition around *begin: returns [lt,gt) holding every
+element equal to the pivot, with [begin,lt) less and [gt,end) greater.
+It does more swaps than the block partition, so partition_range_three_way
+only uses it when the pivot samples hint at duplicates; otherwise the
+equal range is just the pivot itself.
+*/
+template<typename T>
+std::pair<T*,T*> dutch_flag_partition(T* const begin,T* const end)
+{
+    T const pivot=*begin;
+    T* lt=begin;
+    T* i=begin+1;
+    T* gt=end;
+    while(i<gt)
+    {
+        if(*i<pivot)
+        {
+            std::iter_swap(lt++,i++);
+        }
+        else if(pivot<*i)
+        {
+            std::iter_swap(i,--gt);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return std::make_pair(lt,gt);
+}
+
+template<typename T>
+std::pair<T*,T*> partition_range_three_way(T* const begin,T* const end)
+{
+    if(move_pivot_to_front(begin,end))
+    {
+        return dutch_flag_partition(begin,end);
+    }
+    T* const pivot=partition_range(begin,end);
+    return std::make_pair(pivot,pivot+1);
+}
+
+template<typename T>
+void heap_sort_range(T* first,T* last)
+{
+    std::make_heap(first,last);
+    std::sort_heap(first,last);
+}
+
+template<typename T>
+void sequential_sort_range(T* first,T* last,unsigned depth_limit)
+{
+    while(last-first>leaf_size<T>)
+    {
+        if(!depth_limit--)
+        {
+            heap_sort_range(first,last);
+            return;
+        }
+        std::pair<T*,T*> const equal=partition_range_three_way(first,last);
+        if(equal.first-first<last-equal.second)
+        {
+            sequential_sort_range(first,equal.first,depth_limit);
+            first=equal.second;
+        }
+        else
+        {
+            sequential_sort_range(equal.second,last,depth_limit);
+            last=equal.first;
+        }
+    }
+    small_sort_range(first,last);
+}
+
+/*
+Allocation-free chunk handoff. lock_free_stack_rf allocates a node and a
+shared_ptr per push, and each chunk brought a std::promise shared state
+with it: three heap allocations per split, all contending on the
+allocator. The sorter's stacks are intrusive instead. A descriptor
+carries its own next pointer and its completion flag, and comes from the
+pushing thread's node_pool. The pusher waits for its chunk before it
+returns, so it is also the one that puts the descriptor back: each pool
+is only ever touched by its own thread and needs no synchronisation.
+Pools hand out descriptors but never free them while the thread lives,
+so a pop that read a stale head can still safely load its next pointer;
+the tag in the head makes that pop's compare-exchange fail (no ABA).
+*/
+template<typename Node>
+class intrusive_stack
+{
+    struct tagged_ptr
+    {
+        Node* ptr;
+        std::uintptr_t tag;
+    };
+    std::atomic<tagged_ptr> head;
+public:
+    intrusive_stack():
+        head(tagged_ptr{nullptr,0})
+    {}
+
+    void push(Node* node)
+    {
+        tagged_ptr old_head=head.load(std::memory_order_relaxed);
+        tagged_ptr new_head;
+        do
+        {
+            node->next.store(old_head.ptr,std::memory_order_relaxed);
+            new_head=tagged_ptr{node,old_head.tag+1};
+        }
+        while(!head.compare_exchange_weak(old_head,new_head,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+    }
+
+    Node* pop()
+    {
+        tagged_ptr old_head=head.load(std::memory_order_acquire);
+        while(old_head.ptr)
+        {
+            tagged_ptr const new_head{
+                old_head.ptr->next.load(std::memory_order_relaxed),
+                old_head.tag+1};
+            if(head.compare_exchange_weak(old_head,new_head,
+                                          std::memory_order_acquire,
+                                          std::memory_order_acquire))
+            {
+                return old_head.ptr;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// per-thread free list of descriptors; the vector only grows while the
+// recursion gets deeper than it has been on this thread before
+template<typename Node>
+class node_pool
+{
+    std::vector<std::unique_ptr<Node> > storage;
+    Node* free_nodes;
+public:
+    node_pool():
+        free_nodes(nullptr)
+    {}
+
+    node_pool(node_pool const&)=delete;
+    node_pool& operator=(node_pool const&)=delete;
+
+    Node* acquire()
+    {
+        if(!free_nodes)
+        {
+            storage.push_back(std::make_unique<Node>());
+            return storage.back().get();
+        }
+        Node* const node=free_nodes;
+        free_nodes=node->next.load(std::memory_order_relaxed);
+        return node;
+    }
+
+    void release(Node* node)
+    {
+        node->next.store(free_nodes,std::memory_order_relaxed);
+        free_nodes=node;
+    }
+};
+
 template<typename T>
 struct sorter
 {
+    // done is the inline promise: set with release once data holds the
+    // sorted result, after which the worker never touches the chunk again
     struct chunk_to_sort
     {
         std::list<T> data;
-        std::promise<std::list<T> > promise;
+        unsigned depth_limit;
+        std::atomic<bool> done;
+        std::atomic<chunk_to_sort*> next;
+    };
+    struct range_to_sort
+    {
+        T* first;
+        T* last;
+        unsigned depth_limit;
+        std::atomic<bool> done;
+        std::atomic<range_to_sort*> next;
     };
-    lock_free_stack_rf<chunk_to_sort> chunks;
+    intrusive_stack<chunk_to_sort> chunks;
+    intrusive_stack<range_to_sort> ranges;
     std::vector<std::thread> threads;
+    std::mutex threads_mutex;
+    std::atomic<unsigned> thread_count;
     unsigned const max_thread_count;
     std::atomic<bool> end_of_data;
 
+    /*
+    Idle threads spin for a short while and then park on wake_generation
+    with std::atomic::wait (a futex on Linux), so they use no CPU between
+    chunks. Every event a parked thread may be waiting for (a chunk pushed,
+    a chunk finished, shutdown) bumps wake_generation; the futex wake is
+    only issued when parked_threads says someone is actually asleep.
+    A thread loads the generation before its final check, so an event
+    that lands between the check and the wait changes the value and the
+    wait returns immediately.
+    */
+    static constexpr unsigned spin_count=1000;
+    std::atomic<int> pending_chunks;
+    std::atomic<unsigned> wake_generation;
+    std::atomic<unsigned> parked_threads;
+
     sorter():
-        max_thread_count(std::thread::hardware_concurrency()-1),
-        end_of_data(false)
+        thread_count(0),
+        // hardware_concurrency() may return 0; keep at least one worker
+        max_thread_count(std::max(std::thread::hardware_concurrency(),2u)-1),
+        end_of_data(false),
+        pending_chunks(0),
+        wake_generation(0),
+        parked_threads(0)
     {}
 
     ~sorter()
     {
         end_of_data=true;
+        wake_parked_threads();
         for(unsigned i=0;i<threads.size();++i)
         {
             threads[i].join();
         }
     }
 
-    void try_sort_chunk()
+    void wake_parked_threads()
     {
-        std::shared_ptr<chunk_to_sort > chunk=chunks.pop();
-        if(chunk)
+        wake_generation.fetch_add(1);
+        if(parked_threads.load())
         {
-            sort_chunk(chunk);
+            wake_generation.notify_all();
         }
     }
 
-    std::list<T> do_sort(std::list<T>& chunk_data)
+    template<typename Predicate>
+    void spin_then_park(Predicate ready)
     {
-        if(chunk_data.empty())
+        for(unsigned i=0;i<spin_count;++i)
         {
-            return chunk_data;
+            if(ready())
+                return;
         }
+        unsigned const generation=wake_generation.load();
+        ++parked_threads;
+        if(!ready())
+        {
+            wake_generation.wait(generation);
+        }
+        --parked_threads;
+    }
 
-        std::list<T> result;
-        result.splice(result.begin(),chunk_data,chunk_data.begin());
-        T const& partition_val=*result.begin();
-
-        typename std::list<T>::iterator divide_point=
-            std::partition(chunk_data.begin(),chunk_data.end(),
-                           [&](T const& val){return val<partition_val;});
-        chunk_to_sort new_lower_chunk;
-        new_lower_chunk.data.splice(new_lower_chunk.data.end(),
-                                    chunk_data,chunk_data.begin(),
-                                    divide_point);
-
-        std::future<std::list<T> > new_lower=
-            new_lower_chunk.promise.get_future();
-        chunks.push(std::move(new_lower_chunk));
+    // do_sort runs on the workers too, so threads must not be grown unlocked
+    void spawn_thread_if_needed()
+    {
+        if(thread_count.load(std::memory_order_relaxed)>=max_thread_count)
+            return;
+        std::lock_guard<std::mutex> lk(threads_mutex);
         if(threads.size()<max_thread_count)
         {
             threads.push_back(std::thread(&sorter<T>::sort_thread,this));
+            thread_count.store(threads.size(),std::memory_order_relaxed);
         }
+    }
 
-        std::list<T> new_higher(do_sort(chunk_data));
-
-        result.splice(result.end(),new_higher);
-        while(new_lower.wait_for(std::chrono::seconds(0)) !=
-              std::future_status::ready)
+    void start_threads()
+    {
+        while(thread_count.load(std::memory_order_relaxed)<max_thread_count)
         {
-            try_sort_chunk();
+            spawn_thread_if_needed();
         }
+    }
 
-        result.splice(result.begin(),new_lower.get());
-        return result;
+    // one pool per thread for each descriptor type, shared by every
+    // sorter<T> the thread works for
+    static node_pool<chunk_to_sort>& local_chunk_pool()
+    {
+        static thread_local node_pool<chunk_to_sort> pool;
+        return pool;
     }
 
-    void sort_chunk(std::shared_ptr<chunk_to_sort > const& chunk)
+    static node_pool<range_to_sort>& local_range_pool()
     {
-        chunk->promise.set_value(do_sort(chunk->data));
+        static thread_local node_pool<range_to_sort> pool;
+        return pool;
     }
 
-    void sort_thread()
+    bool try_sort_chunk()
     {
-        while(!end_of_data)
+        chunk_to_sort* const chunk=chunks.pop();
+        if(chunk)
         {
-            try_sort_chunk();
-            std::this_thread::yield();
+            --pending_chunks;
+            sort_chunk(chunk);
+            return true;
+        }
+        range_to_sort* const range=ranges.pop();
+        if(range)
+        {
+            --pending_chunks;
+            sort_range(range);
+            return true;
         }
+        return false;
     }
-};
 
-template<typename T>
-std::list<T> parallel_quick_sort(std::list<T> input)
-{
-    if(input.empty())
+    void help_until_ready(std::atomic<bool> const& done)
     {
-        return input;
+        auto const ready=[&]{
+            return done.load(std::memory_order_acquire);
+        };
+        while(!ready())
+        {
+            if(!try_sort_chunk())
+            {
+                spin_then_park([&]{
+                    return pending_chunks.load()>0 || ready();
+                });
+            }
+        }
     }
-    sorter<T> s;
-    return s.do_sort(input);
-}
 
-// void parallel_qs()
-// {
-//   std::list<int> a{5,7,9,12,2,10,1};
-//   auto res = parallel_quick_sort(a);
-//   std::for_each(res.begin(),res.end(), [](auto p){
-//     cout << p << endl;
-//   });
-// }
+    std::list<T> do_sort(std::list<T>& chunk_data,unsigned depth_limit)
+    {
+        if(chunk_data.size()<=max_network_size)
+        {
+            small_sort_list(chunk_data);
+            return std::move(chunk_data);
+        }
+        if(!depth_limit)
+        {
+            chunk_data.sort();
+            return std::move(chunk_data);
+        }
+
+        std::list<T> result;
+        result.splice(result.begin(),chunk_data,choose_pivot(chunk_data));
+        T const& partition_val=*result.begin();
+
+        // three-way partition: the values equal to the pivot are spliced
+        // next to it once and never sorted again. Partitioning values
+        // rather than relinking nodes one by one keeps the nodes in
+        // allocation order, which later passes depend on for locality.
+        typename std::list<T>::iterator divide_point=
+            std::partition(chunk_data.begin(),chunk_data.end(),
+                           [&](T const& val){return val<partition_val;});
+        typename std::list<T>::iterator const equal_end=
+            std::partition(divide_point,chunk_data.end(),
+                           [&](T const& val){return !(partition_val<val);});
+        if(divide_point==chunk_data.begin())
+        {
+            result.splice(result.end(),chunk_data,chunk_data.begin(),
+                          equal_end);
+            result.splice(result.end(),do_sort(chunk_data,depth_limit-1));
+            return result;
+        }
+
+        node_pool<chunk_to_sort>& pool=local_chunk_pool();
+        chunk_to_sort* const new_lower=pool.acquire();
+        new_lower->data.splice(new_lower->data.end(),
+                               chunk_data,chunk_data.begin(),divide_point);
+        result.splice(result.end(),chunk_data,chunk_data.begin(),equal_end);
+        new_lower->depth_limit=depth_limit-1;
+        new_lower->done.store(false,std::memory_order_relaxed);
+
+        chunks.push(new_lower);
+        ++pending_chunks;
+        wake_parked_threads();
+        spawn_thread_if_needed();
+
+        std::list<T> new_higher(do_sort(chunk_data,depth_limit-1));
+
+        result.splice(result.end(),new_higher);
+        help_until_ready(new_lower->done);
+
+        result.splice(result.begin(),new_lower->data);
+        pool.release(new_lower);
+        return result;
+    }
+
+    void do_sort_range(T* first,T* last,unsigned depth_limit)
+    {
+        std::ptrdiff_t const min_parallel_range=1<<14;
+        if(last-first<=min_parallel_range)
+        {
+            sequential_sort_range(first,last,depth_limit);
+            return;
+        }
+        if(!depth_limit)
+        {
+            heap_sort_range(first,last);
+            return;
+        }
+
+        std::pair<T*,T*> const equal=partition_range_three_way(first,last);
+        if(equal.first==first)
+        {
+            do_sort_range(equal.second,last,depth_limit-1);
+            return;
+        }
+        node_pool<range_to_sort>& pool=local_range_pool();
+        range_to_sort* const new_lower=pool.acquire();
+        new_lower->first=first;
+        new_lower->last=equal.first;
+        new_lower->depth_limit=depth_limit-1;
+        new_lower->done.store(false,std::memory_order_relaxed);
+
+        ranges.push(new_lower);
+        ++pending_chunks;
+        wake_parked_threads();
+        spawn_thread_if_needed();
+
+        do_sort_range(equal.second,last,depth_limit-1);
+        help_until_ready(new_lower->done);
+        pool.release(new_lower);
+    }
+
+    void sort_range(range_to_sort* range)
+    {
+        do_sort_range(range->first,range->last,range->depth_limit);
+        range->done.store(true,std::memory_order_release);
+        wake_parked_threads();
+    }
+
+    void sort_chunk(chunk_to_sort* chunk)
+    {
+        std::list<T> sorted(do_sort(chunk->data,chunk->depth_limit));
+        chunk->data.splice(chunk->data.end(),sorted);
+        chunk->done.store(true,std::memory_order_release);
+        wake_parked_threads();
+    }
+
+    void sort_thread()
+    {
+        while(!end_of_data)
+        {
+            if(!try_sort_chunk())
+            {
+                spin_then_park([&]{
+                    return pending_chunks.load()>0 || end_of_data.load();
+                });
+            }
+        }
+    }
+};
+
+template<typename T>
+std::list<T> parallel_quick_sort(std::list<T> input)
+{
+    if(input.empty())
+    {
+        return input;
+    }
+    sorter<T> s;
+    return s.do_sort(input,introsort_depth_limit(input.size()));
+}
+
+template<typename T>
+void parallel_quick_sort(std::span<T> data)
+{
+    if(data.size()<2)
+    {
+        return;
+    }
+    sorter<T> s;
+    s.do_sort_range(data.data(),data.data()+data.size(),
+                    introsort_depth_limit(data.size()));
+}
+
+template<typename T>
+void parallel_quick_sort(std::vector<T>& data)
+{
+    parallel_quick_sort(std::span<T>(data));
+}
+
+/*
+A sorter that outlives the calls made on it: the worker threads and the
+chunk stack are created once and the workers park between calls, so a
+small sort only pays for the partitioning itself.
+The latency of the last latency_window calls is kept in a ring of atomics
+so recording a sample never takes a lock.
+*/
+template<typename T>
+class sorting_engine
+{
+    sorter<T> s;
+    static constexpr unsigned long latency_window=1<<16;
+    std::vector<std::atomic<long long> > latency_ns;
+    std::atomic<unsigned long> calls;
+
+    void record_latency(std::chrono::steady_clock::time_point start)
+    {
+        long long const ns=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now()-start).count();
+        unsigned long const slot=
+            calls.fetch_add(1,std::memory_order_relaxed)%latency_window;
+        latency_ns[slot].store(ns,std::memory_order_relaxed);
+    }
+public:
+    sorting_engine():
+        latency_ns(latency_window),calls(0)
+    {
+        s.start_threads();
+    }
+
+    sorting_engine(sorting_engine const&)=delete;
+    sorting_engine& operator=(sorting_engine const&)=delete;
+
+    void sort(std::list<T>& data)
+    {
+        auto const start=std::chrono::steady_clock::now();
+        if(data.size()>1)
+        {
+            data=s.do_sort(data,introsort_depth_limit(data.size()));
+        }
+        record_latency(start);
+    }
+
+    void sort(std::span<T> data)
+    {
+        auto const start=std::chrono::steady_clock::now();
+        if(data.size()>1)
+        {
+            s.do_sort_range(data.data(),data.data()+data.size(),
+                            introsort_depth_limit(data.size()));
+        }
+        record_latency(start);
+    }
+
+    void sort(std::vector<T>& data)
+    {
+        sort(std::span<T>(data));
+    }
+
+    unsigned long call_count() const
+    {
+        return calls.load();
+    }
+
+    // p in [0,1]; in microseconds, over the most recent latency_window calls
+    double latency_percentile(double p) const
+    {
+        unsigned long const count=
+            std::min(calls.load(),latency_window);
+        if(!count)
+            return 0;
+        std::vector<long long> samples(count);
+        for(unsigned long i=0;i<count;++i)
+        {
+            samples[i]=latency_ns[i].load(std::memory_order_relaxed);
+        }
+        unsigned long const rank=std::min(
+            static_cast<unsigned long>(p*count),count-1);
+        std::nth_element(samples.begin(),samples.begin()+rank,
+                         samples.end());
+        return samples[rank]/1000.0;
+    }
+};
+
+/*
+LSD radix sort for integer and floating point keys, or for records through
+a key extractor returning one. Keys are mapped by radix_encode to unsigned
+integers that order the same way and are sorted a byte per pass.
+Each of T threads owns a fixed block of the input, and every pass runs
+in three phases:
+1. count the digits of the block into that thread's histogram,
+2. at the barrier, prefix-sum the T histograms into per-thread, per-digit
+   write offsets (thread order within a digit keeps the sort stable),
+3. scatter the block through write-combining buffers: elements are staged
+   per digit in a cache-line sized slot and written out a full slot at a
+   time, so the 256 output streams each see whole-line writes.
+Digits are extracted a batch at a time into a byte array in a loop the
+compiler vectorizes for arithmetic keys; counting then spreads over four
+histograms to break the store-to-load chain on runs of equal digits.
+A pass in which every key has the same digit is skipped.
+*/
+template<typename K>
+auto radix_encode(K key)
+{
+    static_assert(std::is_arithmetic<K>::value && !std::is_same<K,bool>::value,
+                  "radix keys must be integers or floating point");
+    if constexpr(std::is_floating_point<K>::value)
+    {
+        static_assert(sizeof(K)==4 || sizeof(K)==8,"float or double keys");
+        typedef typename std::conditional<sizeof(K)==4,
+            std::uint32_t,std::uint64_t>::type bits_type;
+        bits_type const bits=std::bit_cast<bits_type>(key);
+        bits_type const sign=bits_type(1)<<(sizeof(K)*8-1);
+        return (bits&sign)?bits_type(~bits):bits_type(bits|sign);
+    }
+    else
+    {
+        typedef typename std::make_unsigned<K>::type bits_type;
+        bits_type const bits=static_cast<bits_type>(key);
+        if constexpr(std::is_signed<K>::value)
+            return bits_type(bits^(bits_type(1)<<(sizeof(K)*8-1)));
+        else
+            return bits;
+    }
+}
+
+template<typename T>
+struct identity_key
+{
+    T const& operator()(T const& value) const
+    {
+        return value;
+    }
+};
+
+template<typename T,typename KeyFn>
+class radix_sorter
+{
+    typedef typename std::decay<decltype(
+        std::declval<KeyFn const&>()(std::declval<T const&>()))>::type
+        key_type;
+    typedef decltype(radix_encode(std::declval<key_type>())) radix_type;
+
+    static constexpr std::size_t buckets=256;
+    static constexpr unsigned passes=sizeof(radix_type);
+    static constexpr std::size_t digit_batch=256;
+    static constexpr std::size_t wc_slot=sizeof(T)>=64?1:64/sizeof(T);
+    static constexpr std::size_t min_per_thread=1<<16;
+
+    struct alignas(64) thread_state
+    {
+        std::size_t histogram[buckets];
+        std::size_t offset[buckets];
+    };
+
+    struct phase_complete
+    {
+        radix_sorter* self;
+        void operator()() noexcept
+        {
+            self->end_of_phase();
+        }
+    };
+
+    std::span<T> data;
+    std::vector<T> buffer;
+    KeyFn key;
+    unsigned const num_threads;
+    std::vector<thread_state> state;
+    std::barrier<phase_complete> sync;
+    T* src;
+    T* dst;
+    unsigned shift;
+    bool counted;
+    bool skip_pass;
+
+    static unsigned thread_count(std::size_t size)
+    {
+        std::size_t const hardware_threads=
+            std::max(std::thread::hardware_concurrency(),1u);
+        return static_cast<unsigned>(std::max<std::size_t>(
+            1,std::min(hardware_threads,size/min_per_thread)));
+    }
+
+    void extract_digits(T const* first,std::size_t count,
+                        unsigned char* digits) const
+    {
+        for(std::size_t i=0;i<count;++i)
+        {
+            digits[i]=static_cast<unsigned char>(
+                radix_encode(key(first[i]))>>shift);
+        }
+    }
+
+    void count_digits(unsigned index,std::size_t begin,std::size_t end)
+    {
+        std::size_t counts[4][buckets]={};
+        unsigned char digits[digit_batch];
+        for(std::size_t i=begin;i<end;i+=digit_batch)
+        {
+            std::size_t const batch=std::min(digit_batch,end-i);
+            extract_digits(src+i,batch,digits);
+            std::size_t j=0;
+            for(;j+4<=batch;j+=4)
+            {
+                ++counts[0][digits[j]];
+                ++counts[1][digits[j+1]];
+                ++counts[2][digits[j+2]];
+                ++counts[3][digits[j+3]];
+            }
+            for(;j<batch;++j)
+            {
+                ++counts[0][digits[j]];
+            }
+        }
+        for(std::size_t d=0;d<buckets;++d)
+        {
+            state[index].histogram[d]=
+                counts[0][d]+counts[1][d]+counts[2][d]+counts[3][d];
+        }
+    }
+
+    void scatter(unsigned index,std::size_t begin,std::size_t end,
+                 std::vector<T>& staging)
+    {
+        std::size_t* const offset=state[index].offset;
+        unsigned char digits[digit_batch];
+        if constexpr(wc_slot==1)
+        {
+            // an element is already a cache line; staging would only copy
+            for(std::size_t i=begin;i<end;i+=digit_batch)
+            {
+                std::size_t const batch=std::min(digit_batch,end-i);
+                extract_digits(src+i,batch,digits);
+                for(std::size_t j=0;j<batch;++j)
+                {
+                    dst[offset[digits[j]]++]=std::move(src[i+j]);
+                }
+            }
+            return;
+        }
+        unsigned char fill[buckets]={};
+        for(std::size_t i=begin;i<end;i+=digit_batch)
+        {
+            std::size_t const batch=std::min(digit_batch,end-i);
+            extract_digits(src+i,batch,digits);
+            for(std::size_t j=0;j<batch;++j)
+            {
+                unsigned const d=digits[j];
+                T* const slot=staging.data()+d*wc_slot;
+                slot[fill[d]]=std::move(src[i+j]);
+                if(++fill[d]==wc_slot)
+                {
+                    std::move(slot,slot+wc_slot,dst+offset[d]);
+                    offset[d]+=wc_slot;
+                    fill[d]=0;
+                }
+            }
+        }
+        for(std::size_t d=0;d<buckets;++d)
+        {
+            T* const slot=staging.data()+d*wc_slot;
+            std::move(slot,slot+fill[d],dst+offset[d]);
+            offset[d]+=fill[d];
+        }
+    }
+
+    void end_of_phase()
+    {
+        if(!counted)
+        {
+            std::size_t total=0;
+            skip_pass=false;
+            for(std::size_t d=0;d<buckets;++d)
+            {
+                std::size_t digit_total=0;
+                for(unsigned t=0;t<num_threads;++t)
+                {
+                    state[t].offset[d]=total+digit_total;
+                    digit_total+=state[t].histogram[d];
+                }
+                skip_pass=skip_pass || digit_total==data.size();
+                total+=digit_total;
+            }
+        }
+        else
+        {
+            if(!skip_pass)
+                std::swap(src,dst);
+            shift+=8;
+        }
+        counted=!counted;
+    }
+
+    void run(unsigned index)
+    {
+        std::size_t const size=data.size();
+        std::size_t const begin=size*index/num_threads;
+        std::size_t const end=size*(index+1)/num_threads;
+        std::vector<T> staging(buckets*wc_slot);
+        for(unsigned pass=0;pass<passes;++pass)
+        {
+            count_digits(index,begin,end);
+            sync.arrive_and_wait();
+            if(!skip_pass)
+                scatter(index,begin,end,staging);
+            sync.arrive_and_wait();
+        }
+    }
+
+public:
+    radix_sorter(std::span<T> data_,KeyFn key_):
+        data(data_),buffer(data_.size()),key(key_),
+        num_threads(thread_count(data_.size())),
+        state(num_threads),
+        sync(num_threads,phase_complete{this}),
+        src(data_.data()),dst(buffer.data()),
+        shift(0),counted(false),skip_pass(false)
+    {}
+
+    radix_sorter(radix_sorter const&)=delete;
+    radix_sorter& operator=(radix_sorter const&)=delete;
+
+    void sort()
+    {
+        std::vector<std::thread> threads;
+        for(unsigned i=1;i<num_threads;++i)
+        {
+            threads.push_back(std::thread(&radix_sorter::run,this,i));
+        }
+        run(0);
+        for(unsigned i=0;i<threads.size();++i)
+        {
+            threads[i].join();
+        }
+        if(src!=data.data())
+        {
+            std::move(src,src+data.size(),data.data());
+        }
+    }
+};
+
+template<typename T,typename KeyFn=identity_key<T> >
+void parallel_radix_sort(std::span<T> data,KeyFn key=KeyFn())
+{
+    if(data.size()<2)
+    {
+        return;
+    }
+    radix_sorter<T,KeyFn> s(data,key);
+    s.sort();
+}
+
+template<typename T,typename KeyFn=identity_key<T> >
+void parallel_radix_sort(std::vector<T>& data,KeyFn key=KeyFn())
+{
+    parallel_radix_sort(std::span<T>(data),key);
+}
+
+/*
+Stable parallel merge sort. The input is cut into R equal runs (R the
+power of two at or above the thread count), each thread stable-sorts its
+runs, then log2(R) rounds merge neighbouring runs between the input and a
+buffer. Every round gives each thread the same share of the output,
+whichever merges it falls into: merge_path_split finds, for an output
+position k of a merge, how many elements come from the left run (the
+co-rank, a binary search along the merge path's cross diagonal), so a
+thread merges exactly its slice however the keys are distributed.
+Ties take the left run first, which keeps the sort stable.
+*/
+template<typename T,typename Compare>
+std::size_t merge_path_split(T const* a,std::size_t a_size,
+                             T const* b,std::size_t b_size,
+                             std::size_t k,Compare& comp)
+{
+    std::size_t lo=k>b_size?k-b_size:0;
+    std::size_t hi=std::min(k,a_size);
+    while(lo<hi)
+    {
+        std::size_t const i=lo+(hi-lo)/2;
+        std::size_t const j=k-i;
+        // a[i] belongs in the first k unless b[j-1] is strictly smaller
+        if(j>0 && !comp(b[j-1],a[i]))
+            lo=i+1;
+        else
+            hi=i;
+    }
+    return lo;
+}
+
+// std::merge, but moving; ties take from the first range
+template<typename T,typename Compare>
+T* move_merge(T* a,T* a_end,T* b,T* b_end,T* out,Compare& comp)
+{
+    while(a!=a_end && b!=b_end)
+    {
+        if(comp(*b,*a))
+            *out++=std::move(*b++);
+        else
+            *out++=std::move(*a++);
+    }
+    out=std::move(a,a_end,out);
+    return std::move(b,b_end,out);
+}
+
+template<typename T,typename Compare>
+class merge_sorter
+{
+    static constexpr std::size_t min_per_thread=1<<14;
+
+    struct phase_complete
+    {
+        merge_sorter* self;
+        void operator()() noexcept
+        {
+            if(!self->runs_sorted)
+            {
+                self->runs_sorted=true;
+                return;
+            }
+            std::swap(self->src,self->dst);
+            self->width*=2;
+        }
+    };
+
+    std::span<T> data;
+    std::vector<T> buffer;
+    Compare comp;
+    unsigned const num_threads;
+    std::size_t const num_runs;
+    std::barrier<phase_complete> sync;
+    std::barrier<> splits_found;
+    T* src;
+    T* dst;
+    std::size_t width;
+    bool runs_sorted;
+
+    static unsigned thread_count(std::size_t size)
+    {
+        std::size_t const hardware_threads=
+            std::max(std::thread::hardware_concurrency(),1u);
+        return static_cast<unsigned>(std::max<std::size_t>(
+            1,std::min(hardware_threads,size/min_per_thread)));
+    }
+
+    static std::size_t run_count(unsigned threads)
+    {
+        std::size_t runs=1;
+        while(runs<threads)
+            runs*=2;
+        return runs;
+    }
+
+    std::size_t run_begin(std::size_t run) const
+    {
+        return data.size()*run/num_runs;
+    }
+
+    struct merge_segment
+    {
+        std::size_t lo,mid,k0,k1,i0,i1;
+    };
+
+    // the merges move elements out of src, so every thread finds its
+    // split points (which read src) before any thread starts moving
+    void merge_slice(std::size_t slice_begin,std::size_t slice_end)
+    {
+        std::vector<merge_segment> segments;
+        std::size_t const group=2*width;
+        for(std::size_t first_run=0;first_run<num_runs;first_run+=group)
+        {
+            std::size_t const lo=run_begin(first_run);
+            std::size_t const mid=run_begin(first_run+width);
+            std::size_t const hi=run_begin(first_run+group);
+            if(hi<=slice_begin || lo>=slice_end)
+                continue;
+            std::size_t const k0=std::max(slice_begin,lo)-lo;
+            std::size_t const k1=std::min(slice_end,hi)-lo;
+            T* const a=src+lo;
+            T* const b=src+mid;
+            std::size_t const a_size=mid-lo;
+            std::size_t const b_size=hi-mid;
+            std::size_t const i0=merge_path_split(a,a_size,b,b_size,k0,comp);
+            std::size_t const i1=merge_path_split(a,a_size,b,b_size,k1,comp);
+            segments.push_back(merge_segment{lo,mid,k0,k1,i0,i1});
+        }
+        splits_found.arrive_and_wait();
+        for(auto const& s: segments)
+        {
+            T* const a=src+s.lo;
+            T* const b=src+s.mid;
+            move_merge(a+s.i0,a+s.i1,b+(s.k0-s.i0),b+(s.k1-s.i1),
+                       dst+s.lo+s.k0,comp);
+        }
+    }
+
+    void run(unsigned index)
+    {
+        for(std::size_t r=index;r<num_runs;r+=num_threads)
+        {
+            std::stable_sort(src+run_begin(r),src+run_begin(r+1),comp);
+        }
+        std::size_t const slice_begin=data.size()*index/num_threads;
+        std::size_t const slice_end=data.size()*(index+1)/num_threads;
+        // src, dst and width only change in the barrier completion step
+        sync.arrive_and_wait();
+        while(width<num_runs)
+        {
+            merge_slice(slice_begin,slice_end);
+            sync.arrive_and_wait();
+        }
+        if(src!=data.data())
+        {
+            std::move(src+slice_begin,src+slice_end,data.data()+slice_begin);
+        }
+    }
+
+public:
+    merge_sorter(std::span<T> data_,Compare comp_):
+        data(data_),comp(comp_),
+        num_threads(thread_count(data_.size())),
+        num_runs(run_count(num_threads)),
+        sync(num_threads,phase_complete{this}),
+        splits_found(num_threads),
+        src(data_.data()),dst(nullptr),
+        width(1),runs_sorted(false)
+    {
+        if(num_runs>1)
+        {
+            buffer.resize(data.size());
+            dst=buffer.data();
+        }
+    }
+
+    merge_sorter(merge_sorter const&)=delete;
+    merge_sorter& operator=(merge_sorter const&)=delete;
+
+    void sort()
+    {
+        std::vector<std::thread> threads;
+        for(unsigned i=1;i<num_threads;++i)
+        {
+            threads.push_back(std::thread(&merge_sorter::run,this,i));
+        }
+        run(0);
+        for(unsigned i=0;i<threads.size();++i)
+        {
+            threads[i].join();
+        }
+    }
+};
+template<typename T,typename Compare=std::less<T> >
+void parallel_merge_sort(std::span<T> data,Compare comp=Compare())
+{
+    if(data.size()<2)
+    {
+        return;
+    }
+    merge_sorter<T,Compare> s(data,comp);
+    s.sort();
+}
+
+template<typename T,typename Compare=std::less<T> >
+void parallel_merge_sort(std::vector<T>& data,Compare comp=Compare())
+{
+    parallel_merge_sort(std::span<T>(data),comp);
+}
+
+/*
+Indirect mode for records that are large or expensive to move: only a
+permutation of 32-bit indices, or (key,index) pairs, is sorted. The
+pairs carry the key inline, so the merges never touch the records; the
+plain permutation is smaller but looks each record up per comparison.
+Both are stable, and data[perm[i]] / data[pairs[i].second] walks the
+records in order.
+*/
+template<typename T,typename Compare=std::less<T> >
+std::vector<std::uint32_t> parallel_merge_sort_indices(
+    std::span<T const> data,Compare comp=Compare())
+{
+    if(data.size()>std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::length_error("too many elements for 32-bit indices");
+    }
+    std::vector<std::uint32_t> permutation(data.size());
+    std::iota(permutation.begin(),permutation.end(),0u);
+    parallel_merge_sort(permutation,
+                        [&data,&comp](std::uint32_t a,std::uint32_t b)
+                        {
+                            return comp(data[a],data[b]);
+                        });
+    return permutation;
+}
+
+template<typename T,typename KeyFn>
+auto parallel_merge_sort_key_index(std::span<T const> data,KeyFn key)
+{
+    typedef typename std::decay<decltype(key(data[0]))>::type key_type;
+    if(data.size()>std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::length_error("too many elements for 32-bit indices");
+    }
+    std::vector<std::pair<key_type,std::uint32_t> > pairs(data.size());
+    for(std::size_t i=0;i<data.size();++i)
+    {
+        pairs[i].first=key(data[i]);
+        pairs[i].second=static_cast<std::uint32_t>(i);
+    }
+    parallel_merge_sort(pairs,
+                        [](std::pair<key_type,std::uint32_t> const& a,
+                           std::pair<key_type,std::uint32_t> const& b)
+                        {
+                            return a.first<b.first;
+                        });
+    return pairs;
+}
+
+/*
+Selection. Finding a rank only needs the side of each partition that
+holds it, so there is nothing to fork; the parallelism has to come from
+the partition itself. Each round, every thread partitions its own slice
+of the current range around the shared pivot, which leaves the range as
+[less|rest][less|rest]... The completion step of the barrier adds up the
+counts to find the boundary and lists the misplaced intervals on both
+sides of it (the rest-parts before the boundary, the less-parts after
+it); as many elements are misplaced on each side, so the threads then
+swap equal shares of them pairwise. Only the side holding nth is kept.
+A round that leaves the range unchanged (every element at least the
+pivot) partitions by "not greater" instead, which either finds nth among
+the pivot's equals or moves past them.
+Once the range falls below num_threads*min_per_thread, or after
+introsort_depth_limit rounds, it is finished by sequential_select_range,
+the quicksort partition_range_three_way iterated into one side.
+*/
+template<typename T>
+void sequential_select_range(T* first,T* last,T* nth,unsigned depth_limit)
+{
+    while(last-first>leaf_size<T>)
+    {
+        if(!depth_limit--)
+        {
+            std::nth_element(first,nth,last);
+            return;
+        }
+        std::pair<T*,T*> const equal=partition_range_three_way(first,last);
+        if(nth<equal.first)
+            last=equal.first;
+        else if(nth>=equal.second)
+            first=equal.second;
+        else
+            return;
+    }
+    small_sort_range(first,last);
+}
+
+template<typename T>
+class selector
+{
+    static constexpr std::size_t min_per_thread=1<<16;
+
+    struct interval
+    {
+        T* first;
+        T* last;
+    };
+
+    struct collect_misplaced
+    {
+        selector* self;
+        void operator()() noexcept
+        {
+            self->find_misplaced();
+        }
+    };
+
+    struct choose_side
+    {
+        selector* self;
+        void operator()() noexcept
+        {
+            self->next_range();
+        }
+    };
+
+    T* first;
+    T* last;
+    T* const nth;
+    unsigned const num_threads;
+    T pivot;
+    bool by_less;
+    bool finished;
+    bool found;
+    unsigned rounds_left;
+    T* boundary;
+    std::size_t misplaced;
+    std::vector<T*> split;
+    std::vector<interval> misplaced_left;
+    std::vector<interval> misplaced_right;
+    std::barrier<collect_misplaced> partitioned;
+    std::barrier<choose_side> swapped;
+
+    static unsigned thread_count(std::size_t size)
+    {
+        std::size_t const hardware_threads=
+            std::max(std::thread::hardware_concurrency(),1u);
+        return static_cast<unsigned>(std::max<std::size_t>(
+            1,std::min(hardware_threads,size/min_per_thread)));
+    }
+
+    T* slice_begin(unsigned index) const
+    {
+        return first+(last-first)*index/num_threads;
+    }
+
+    bool parallel_worthwhile() const
+    {
+        return num_threads>1 &&
+            static_cast<std::size_t>(last-first)>=num_threads*min_per_thread;
+    }
+
+    void pick_pivot()
+    {
+        std::ptrdiff_t const step=(last-first-1)/8;
+        T* const s=first;
+        pivot=*median_of_three(median_of_three(s,s+step,s+2*step),
+                               median_of_three(s+3*step,s+4*step,s+5*step),
+                               median_of_three(s+6*step,s+7*step,s+8*step));
+        by_less=true;
+    }
+
+    void start_round()
+    {
+        if(!rounds_left-- || !parallel_worthwhile())
+        {
+            finished=true;
+            return;
+        }
+        pick_pivot();
+    }
+
+    void find_misplaced()
+    {
+        std::size_t total=0;
+        for(unsigned i=0;i<num_threads;++i)
+            total+=split[i]-slice_begin(i);
+        boundary=first+total;
+        misplaced_left.clear();
+        misplaced_right.clear();
+        misplaced=0;
+        for(unsigned i=0;i<num_threads;++i)
+        {
+            T* const end=slice_begin(i+1);
+            T* const left_end=std::min(end,boundary);
+            if(split[i]<left_end)
+            {
+                misplaced_left.push_back(interval{split[i],left_end});
+                misplaced+=left_end-split[i];
+            }
+            T* const right_begin=std::max(slice_begin(i),boundary);
+            if(right_begin<split[i])
+                misplaced_right.push_back(interval{right_begin,split[i]});
+        }
+    }
+
+    void next_range()
+    {
+        if(nth<boundary)
+        {
+            if(by_less)
+            {
+                last=boundary;
+                start_round();
+            }
+            else
+            {
+                found=true;
+                finished=true;
+            }
+        }
+        else if(boundary==first && by_less)
+        {
+            by_less=false;
+        }
+        else
+        {
+            first=boundary;
+            start_round();
+        }
+    }
+
+    static T* position(std::vector<interval> const& intervals,std::size_t k,
+                       std::size_t& which)
+    {
+        which=0;
+        while(k>=static_cast<std::size_t>(intervals[which].last-
+                                          intervals[which].first))
+        {
+            k-=intervals[which].last-intervals[which].first;
+            ++which;
+        }
+        return intervals[which].first+k;
+    }
+
+    void swap_share(unsigned index)
+    {
+        std::size_t const k0=misplaced*index/num_threads;
+        std::size_t const k1=misplaced*(index+1)/num_threads;
+        if(k0==k1)
+            return;
+        std::size_t l=0,r=0;
+        T* left=position(misplaced_left,k0,l);
+        T* right=position(misplaced_right,k0,r);
+        for(std::size_t k=k0;k<k1;++k)
+        {
+            if(left==misplaced_left[l].last)
+                left=misplaced_left[++l].first;
+            if(right==misplaced_right[r].last)
+                right=misplaced_right[++r].first;
+            std::iter_swap(left++,right++);
+        }
+    }
+
+    void run(unsigned index)
+    {
+        while(!finished)
+        {
+            T* const begin=slice_begin(index);
+            T* const end=slice_begin(index+1);
+            if(by_less)
+                split[index]=std::partition(begin,end,[&](T const& x){
+                    return x<pivot;
+                });
+            else
+                split[index]=std::partition(begin,end,[&](T const& x){
+                    return !(pivot<x);
+                });
+            partitioned.arrive_and_wait();
+            swap_share(index);
+            swapped.arrive_and_wait();
+        }
+    }
+
+public:
+    selector(std::span<T> data,std::size_t n):
+        first(data.data()),last(data.data()+data.size()),
+        nth(data.data()+n),
+        num_threads(thread_count(data.size())),
+        pivot(*nth),by_less(true),finished(false),found(false),
+        rounds_left(introsort_depth_limit(data.size())),
+        boundary(nullptr),misplaced(0),
+        split(num_threads),
+        partitioned(num_threads,collect_misplaced{this}),
+        swapped(num_threads,choose_side{this})
+    {
+        misplaced_left.reserve(num_threads);
+        misplaced_right.reserve(num_threads);
+        start_round();
+    }
+
+    selector(selector const&)=delete;
+    selector& operator=(selector const&)=delete;
+
+    void select()
+    {
+        std::vector<std::thread> threads;
+        for(unsigned i=1;i<num_threads && !finished;++i)
+        {
+            threads.push_back(std::thread(&selector::run,this,i));
+        }
+        run(0);
+        for(unsigned i=0;i<threads.size();++i)
+        {
+            threads[i].join();
+        }
+        if(!found)
+        {
+            sequential_select_range(first,last,nth,
+                                    introsort_depth_limit(last-first));
+        }
+    }
+};
+
+// data[n] ends up holding the value it would have if data were sorted,
+// with nothing greater before it and nothing less after it
+template<typename T>
+void parallel_nth_element(std::span<T> data,std::size_t n)
+{
+    if(n>=data.size())
+    {
+        return;
+    }
+    selector<T> s(data,n);
+    s.select();
+}
+
+template<typename T>
+void parallel_nth_element(std::vector<T>& data,std::size_t n)
+{
+    parallel_nth_element(std::span<T>(data),n);
+}
+
+// the k smallest values, sorted, at the front of data
+template<typename T>
+void parallel_partial_sort(std::span<T> data,std::size_t k)
+{
+    k=std::min(k,data.size());
+    if(k<data.size())
+    {
+        parallel_nth_element(data,k);
+    }
+    parallel_quick_sort(data.first(k));
+}
+
+template<typename T>
+void parallel_partial_sort(std::vector<T>& data,std::size_t k)
+{
+    parallel_partial_sort(std::span<T>(data),k);
+}
+
+/*
+Streaming top-k: each producer pushes into its own top_k_heap, a min-heap
+capped at k elements whose front is the smallest value still kept, so a
+value is only compared once unless it beats that. merge_top_k gathers
+the heaps at the end. parallel_top_k gives each thread a slice of the
+input and a heap, so the threads share nothing until the merge.
+*/
+template<typename T>
+class top_k_heap
+{
+    std::size_t k;
+    std::vector<T> heap;
+
+    static bool greater(T const& a,T const& b)
+    {
+        return b<a;
+    }
+public:
+    explicit top_k_heap(std::size_t k_):
+        k(k_)
+    {
+        heap.reserve(k);
+    }
+
+    void push(T const& value)
+    {
+        if(heap.size()<k)
+        {
+            heap.push_back(value);
+            std::push_heap(heap.begin(),heap.end(),greater);
+        }
+        else if(k && heap.front()<value)
+        {
+            std::pop_heap(heap.begin(),heap.end(),greater);
+            heap.back()=value;
+            std::push_heap(heap.begin(),heap.end(),greater);
+        }
+    }
+
+    std::vector<T> const& values() const
+    {
+        return heap;
+    }
+};
+
+// the k largest values over all the heaps, largest first
+template<typename T>
+std::vector<T> merge_top_k(std::vector<top_k_heap<T> > const& heaps,
+                           std::size_t k)
+{
+    std::vector<T> result;
+    for(auto const& heap: heaps)
+    {
+        result.insert(result.end(),heap.values().begin(),
+                      heap.values().end());
+    }
+    auto const greater=[](T const& a,T const& b){return b<a;};
+    if(result.size()>k)
+    {
+        std::nth_element(result.begin(),result.begin()+k,result.end(),
+                         greater);
+        result.resize(k);
+    }
+    std::sort(result.begin(),result.end(),greater);
+    return result;
+}
+
+template<typename T>
+std::vector<T> parallel_top_k(std::span<T const> data,std::size_t k)
+{
+    std::size_t const min_per_thread=1<<16;
+    std::size_t const hardware_threads=
+        std::max(std::thread::hardware_concurrency(),1u);
+    unsigned const num_threads=static_cast<unsigned>(std::max<std::size_t>(
+        1,std::min(hardware_threads,data.size()/min_per_thread)));
+    std::vector<top_k_heap<T> > heaps(num_threads,top_k_heap<T>(k));
+    auto const scan=[&](unsigned index){
+        std::size_t const begin=data.size()*index/num_threads;
+        std::size_t const end=data.size()*(index+1)/num_threads;
+        for(std::size_t i=begin;i<end;++i)
+            heaps[index].push(data[i]);
+    };
+    std::vector<std::thread> threads;
+    for(unsigned i=1;i<num_threads;++i)
+    {
+        threads.push_back(std::thread(scan,i));
+    }
+    scan(0);
+    for(unsigned i=0;i<threads.size();++i)
+    {
+        threads[i].join();
+    }
+    return merge_top_k(heaps,k);
+}
+
+template<typename T>
+std::vector<T> parallel_top_k(std::vector<T> const& data,std::size_t k)
+{
+    return parallel_top_k(std::span<T const>(data),k);
+}
+
+/*
+External sort for files of trivially copyable records that do not fit in
+memory. Nothing here holds more than memory_budget bytes of records:
+
+1. Run formation. The input is read into one of two buffers of half the
+   budget, sorted by the persistent sorting_engine and handed to the I/O
+   thread to spill to a temporary file, while the next run is read into
+   the other buffer.
+2. Merge. Up to max_fan_in() runs are merged at once through a loser tree
+   (log2(k) comparisons per record, and only along one leaf-to-root path).
+   Every run reader and the output writer own two blocks: the merge
+   consumes one while the I/O thread fills (or drains) the other, so the
+   disk and the comparisons overlap. The block size is the budget divided
+   over all 2*(k+1) blocks; if that would fall under min_block_bytes the
+   runs are merged in groups first, one extra pass over the data each.
+
+Ties in the merge go to the earlier run, so the output does not depend on
+the timing of the I/O thread. I/O errors surface as std::runtime_error from sort_file.
+*/
+class io_thread
+{
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::packaged_task<std::size_t()> > jobs;
+    bool done;
+    std::thread worker;
+
+    void run()
+    {
+        for(;;)
+        {
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk,[&]{return done || !jobs.empty();});
+            if(jobs.empty())
+                return;
+            std::packaged_task<std::size_t()> job=std::move(jobs.front());
+            jobs.pop_front();
+            lk.unlock();
+            job();
+        }
+    }
+public:
+    io_thread():
+        done(false),worker(&io_thread::run,this)
+    {}
+
+    ~io_thread()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            done=true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    io_thread(io_thread const&)=delete;
+    io_thread& operator=(io_thread const&)=delete;
+
+    template<typename F>
+    std::future<std::size_t> submit(F f)
+    {
+        std::packaged_task<std::size_t()> job(std::move(f));
+        std::future<std::size_t> res=job.get_future();
+        {
+            std::lock_guard<std::mutex> lk(m);
+            jobs.push_back(std::move(job));
+        }
+        cv.notify_one();
+        return res;
+    }
+};
+
+struct file_closer
+{
+    void operator()(std::FILE* f) const
+    {
+        std::fclose(f);
+    }
+};
+typedef std::unique_ptr<std::FILE,file_closer> file_ptr;
+
+inline file_ptr open_file(std::filesystem::path const& path,char const* mode)
+{
+    file_ptr f(std::fopen(path.c_str(),mode));
+    if(!f)
+    {
+        throw std::runtime_error("cannot open "+path.string());
+    }
+    return f;
+}
+
+template<typename T>
+std::size_t read_records(std::FILE* f,T* data,std::size_t count)
+{
+    std::size_t const got=std::fread(data,sizeof(T),count,f);
+    if(got<count && std::ferror(f))
+    {
+        throw std::runtime_error("read error");
+    }
+    return got;
+}
+
+template<typename T>
+std::size_t write_records(std::FILE* f,T const* data,std::size_t count)
+{
+    if(std::fwrite(data,sizeof(T),count,f)!=count)
+    {
+        throw std::runtime_error("write error");
+    }
+    return count;
+}
+
+// run reader: the merge reads block[current] while block[1-current] is
+// being filled by the I/O thread
+template<typename T>
+class run_reader
+{
+    file_ptr file;
+    io_thread& io;
+    std::vector<T> block[2];
+    std::future<std::size_t> pending;
+    unsigned current;
+    std::size_t pos;
+    std::size_t size;
+
+    void prefetch()
+    {
+        std::FILE* const f=file.get();
+        T* const data=block[1-current].data();
+        std::size_t const count=block[1-current].size();
+        pending=io.submit([f,data,count]{
+            return read_records(f,data,count);
+        });
+    }
+public:
+    run_reader(std::filesystem::path const& path,io_thread& io_,
+               std::size_t block_records):
+        file(open_file(path,"rb")),io(io_),current(0),pos(0),size(0)
+    {
+        block[0].resize(block_records);
+        block[1].resize(block_records);
+        prefetch();
+        next_block();
+    }
+
+    ~run_reader()
+    {
+        if(pending.valid())
+            pending.wait();
+    }
+
+    bool exhausted() const
+    {
+        return pos==size;
+    }
+
+    T const& head() const
+    {
+        return block[current][pos];
+    }
+
+    void next_block()
+    {
+        current=1-current;
+        size=pending.get();
+        pos=0;
+        if(size)
+            prefetch();
+    }
+
+    void advance()
+    {
+        if(++pos==size)
+            next_block();
+    }
+};
+
+template<typename T>
+class run_writer
+{
+    file_ptr file;
+    io_thread& io;
+    std::vector<T> block[2];
+    std::future<std::size_t> pending;
+    unsigned current;
+    std::size_t pos;
+
+    void flush()
+    {
+        if(pending.valid())
+            pending.get();
+        std::FILE* const f=file.get();
+        T const* const data=block[current].data();
+        std::size_t const count=pos;
+        pending=io.submit([f,data,count]{
+            return write_records(f,data,count);
+        });
+        current=1-current;
+        pos=0;
+    }
+public:
+    run_writer(std::filesystem::path const& path,io_thread& io_,
+               std::size_t block_records):
+        file(open_file(path,"wb")),io(io_),current(0),pos(0)
+    {
+        block[0].resize(block_records);
+        block[1].resize(block_records);
+    }
+
+    ~run_writer()
+    {
+        if(pending.valid())
+            pending.wait();
+    }
+
+    void push(T const& value)
+    {
+        block[current][pos]=value;
+        if(++pos==block[current].size())
+            flush();
+    }
+
+    void close()
+    {
+        if(pos)
+            flush();
+        if(pending.valid())
+            pending.get();
+        if(std::fflush(file.get()))
+            throw std::runtime_error("write error");
+        file.reset();
+    }
+};
+
+/*
+Loser tree over k sources: tree[0] holds the winner (the source with the
+smallest head) and tree[n] the loser of the match at internal node n,
+with the leaves implicitly at k..2k-1. After the winner advances, only
+the matches on its path to the root are replayed.
+*/
+template<typename T,typename Compare>
+class loser_tree
+{
+    std::vector<run_reader<T>*> const& sources;
+    Compare& comp;
+    std::vector<unsigned> tree;
+
+    bool beats(unsigned a,unsigned b) const
+    {
+        if(sources[a]->exhausted())
+            return false;
+        if(sources[b]->exhausted())
+            return true;
+        T const& x=sources[a]->head();
+        T const& y=sources[b]->head();
+        return comp(x,y) || (!comp(y,x) && a<b);
+    }
+public:
+    loser_tree(std::vector<run_reader<T>*> const& sources_,Compare& comp_):
+        sources(sources_),comp(comp_),tree(sources_.size())
+    {
+        unsigned const k=static_cast<unsigned>(sources.size());
+        std::vector<unsigned> winner(2*k);
+        for(unsigned i=0;i<k;++i)
+            winner[k+i]=i;
+        for(unsigned n=k-1;n>0;--n)
+        {
+            unsigned const a=winner[2*n];
+            unsigned const b=winner[2*n+1];
+            winner[n]=beats(a,b)?a:b;
+            tree[n]=beats(a,b)?b:a;
+        }
+        tree[0]=winner[k>1?1:k];
+    }
+
+    unsigned winner() const
+    {
+        return tree[0];
+    }
+
+    bool empty() const
+    {
+        return sources[tree[0]]->exhausted();
+    }
+
+    void replay()
+    {
+        unsigned const k=static_cast<unsigned>(sources.size());
+        unsigned w=tree[0];
+        for(unsigned n=(w+k)/2;n>0;n/=2)
+        {
+            if(beats(tree[n],w))
+                std::swap(tree[n],w);
+        }
+        tree[0]=w;
+    }
+};
+
+struct external_sort_stats
+{
+    std::uintmax_t bytes;
+    std::size_t runs;
+    unsigned merge_passes;
+    double run_seconds;
+    double merge_seconds;
+    std::size_t peak_buffer_bytes;
+
+    double mb_per_second() const
+    {
+        return bytes/1e6/(run_seconds+merge_seconds);
+    }
+};
+
+template<typename T,typename Compare=std::less<T> >
+class external_sorter
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "records are read and written as raw bytes");
+    static constexpr std::size_t min_block_bytes=1<<16;
+    // well under the usual limit of 1024 open files
+    static constexpr std::size_t max_merge_width=256;
+
+    std::size_t const memory_budget;
+    std::filesystem::path const temp_dir;
+    // sorting_engine uses operator<; a custom order sorts its runs with
+    // parallel_merge_sort instead, and T need not have operator< at all
+    struct no_engine {};
+    static constexpr bool use_engine=std::is_same<Compare,std::less<T> >::value;
+    Compare comp;
+    typename std::conditional<use_engine,sorting_engine<T>,no_engine>::type
+        engine;
+    io_thread io;
+
+    // mkstemp creates the file, so no other sorter sharing temp_dir, in
+    // this process or another, can be handed the same name. The path is
+    // recorded before anything is written, for sort_file to clean up.
+    std::filesystem::path new_run_file(
+        std::vector<std::filesystem::path>& temp_files)
+    {
+        std::string name=(temp_dir/"external_sort_XXXXXX").string();
+        int const fd=::mkstemp(name.data());
+        if(fd<0)
+        {
+            throw std::runtime_error("cannot create a run file in "+
+                                     temp_dir.string());
+        }
+        ::close(fd);
+        temp_files.push_back(name);
+        return temp_files.back();
+    }
+
+    std::size_t max_fan_in() const
+    {
+        return std::min(max_merge_width,memory_budget/(2*min_block_bytes)-1);
+    }
+
+    std::vector<std::filesystem::path> make_runs(
+        std::FILE* input,external_sort_stats& stats,
+        std::vector<std::filesystem::path>& temp_files)
+    {
+        // two run buffers, plus parallel_merge_sort's run-sized scratch
+        // buffer when there is no engine
+        std::size_t const run_buffers=use_engine?2:3;
+        std::size_t const run_records=
+            std::max<std::size_t>(1,memory_budget/run_buffers/sizeof(T));
+        std::vector<T> buffer[2];
+        std::future<std::size_t> written[2];
+        file_ptr files[2];
+        // destroyed before files and buffer: if anything below throws,
+        // the io thread may still be writing the other run, and these
+        // futures (from a packaged_task) do not wait by themselves
+        struct pending_writes
+        {
+            std::future<std::size_t>* written;
+            ~pending_writes()
+            {
+                for(unsigned b=0;b<2;++b)
+                {
+                    if(written[b].valid())
+                        written[b].wait();
+                }
+            }
+        } const wait_on_unwind{written};
+        std::vector<std::filesystem::path> runs;
+        stats.peak_buffer_bytes=run_buffers*run_records*sizeof(T);
+        for(unsigned b=0;;b=1-b)
+        {
+            if(written[b].valid())
+                written[b].get();
+            files[b].reset();
+            buffer[b].resize(run_records);
+            std::size_t const got=read_records(input,buffer[b].data(),
+                                               run_records);
+            if(!got)
+                break;
+            buffer[b].resize(got);
+            if constexpr(use_engine)
+                engine.sort(buffer[b]);
+            else
+                parallel_merge_sort(buffer[b],comp);
+            runs.push_back(new_run_file(temp_files));
+            files[b]=open_file(runs.back(),"wb");
+            std::FILE* const f=files[b].get();
+            T const* const data=buffer[b].data();
+            written[b]=io.submit([f,data,got]{
+                std::size_t const n=write_records(f,data,got);
+                if(std::fflush(f))
+                    throw std::runtime_error("write error");
+                return n;
+            });
+            if(got<run_records)
+                break;
+        }
+        for(unsigned b=0;b<2;++b)
+        {
+            if(written[b].valid())
+                written[b].get();
+            files[b].reset();
+        }
+        stats.runs=runs.size();
+        return runs;
+    }
+
+    void merge(std::vector<std::filesystem::path> const& runs,
+               std::filesystem::path const& output,
+               external_sort_stats& stats)
+    {
+        std::size_t const block_bytes=std::max(
+            min_block_bytes,memory_budget/(2*(runs.size()+1)));
+        std::size_t const block_records=
+            std::max<std::size_t>(1,block_bytes/sizeof(T));
+        stats.peak_buffer_bytes=std::max(
+            stats.peak_buffer_bytes,
+            2*(runs.size()+1)*block_records*sizeof(T));
+
+        std::vector<std::unique_ptr<run_reader<T> > > readers;
+        std::vector<run_reader<T>*> sources;
+        for(auto const& run: runs)
+        {
+            readers.push_back(std::make_unique<run_reader<T> >(
+                                  run,io,block_records));
+            sources.push_back(readers.back().get());
+        }
+        run_writer<T> writer(output,io,block_records);
+        loser_tree<T,Compare> tree(sources,comp);
+        while(!tree.empty())
+        {
+            run_reader<T>& top=*sources[tree.winner()];
+            writer.push(top.head());
+            top.advance();
+            tree.replay();
+        }
+        writer.close();
+    }
+
+public:
+    explicit external_sorter(std::size_t memory_budget_,
+                             std::filesystem::path temp_dir_=
+                                 std::filesystem::temp_directory_path(),
+                             Compare comp_=Compare()):
+        memory_budget(memory_budget_),temp_dir(std::move(temp_dir_)),
+        comp(comp_)
+    {
+        // two blocks for each of at least two runs and for the output
+        if(memory_budget<6*min_block_bytes)
+        {
+            throw std::invalid_argument("memory budget below 384 KiB");
+        }
+    }
+
+    external_sorter(external_sorter const&)=delete;
+    external_sorter& operator=(external_sorter const&)=delete;
+
+    external_sort_stats sort_file(std::filesystem::path const& input,
+                                  std::filesystem::path const& output)
+    {
+        external_sort_stats stats{};
+        stats.bytes=std::filesystem::file_size(input);
+        if(stats.bytes%sizeof(T))
+        {
+            throw std::runtime_error(input.string()+
+                                     " is not a whole number of records");
+        }
+
+        // every run file ever created, including the ones already merged
+        // away, so a throw at any point leaves nothing behind
+        std::vector<std::filesystem::path> temp_files;
+        auto const remove_runs=[&]{
+            for(auto const& run: temp_files)
+            {
+                std::error_code ec;
+                std::filesystem::remove(run,ec);
+            }
+        };
+        std::vector<std::filesystem::path> runs;
+        try
+        {
+            auto const start=std::chrono::steady_clock::now();
+            {
+                file_ptr const in=open_file(input,"rb");
+                runs=make_runs(in.get(),stats,temp_files);
+            }
+            auto const runs_done=std::chrono::steady_clock::now();
+
+            std::size_t const fan_in=max_fan_in();
+            while(runs.size()>fan_in)
+            {
+                std::vector<std::filesystem::path> merged;
+                for(std::size_t i=0;i<runs.size();i+=fan_in)
+                {
+                    std::vector<std::filesystem::path> group(
+                        runs.begin()+i,
+                        runs.begin()+std::min(i+fan_in,runs.size()));
+                    merged.push_back(new_run_file(temp_files));
+                    merge(group,merged.back(),stats);
+                    for(auto const& run: group)
+                        std::filesystem::remove(run);
+                }
+                runs.swap(merged);
+                ++stats.merge_passes;
+            }
+            if(runs.empty())
+                open_file(output,"wb");
+            else
+                merge(runs,output,stats);
+            ++stats.merge_passes;
+            auto const stop=std::chrono::steady_clock::now();
+
+            stats.run_seconds=std::chrono::duration<double>(
+                runs_done-start).count();
+            stats.merge_seconds=std::chrono::duration<double>(
+                stop-runs_done).count();
+        }
+        catch(...)
+        {
+            remove_runs();
+            throw;
+        }
+        remove_runs();
+        return stats;
+    }
+};
+
+/*
+Counting allocator for the benchmarks: every plain operator new in the
+program bumps heap_allocations, so a benchmark can read the count before
+and after the code it measures.
+*/
+std::atomic<unsigned long> heap_allocations(0);
+
+// the forms that call malloc and free stay out of line: gcc inlines them
+// otherwise, then sees malloc paired with operator delete (or operator
+// new with free) and warns -Wmismatched-new-delete
+[[gnu::noinline]] void* operator new(std::size_t size)
+{
+    heap_allocations.fetch_add(1,std::memory_order_relaxed);
+    if(void* const p=std::malloc(size?size:1))
+        return p;
+    throw std::bad_alloc();
+}
+
+// std::stable_sort's temporary buffer comes from the nothrow form
+[[gnu::noinline]] void* operator new(std::size_t size,
+                                     std::nothrow_t const&) noexcept
+{
+    heap_allocations.fetch_add(1,std::memory_order_relaxed);
+    return std::malloc(size?size:1);
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new[](std::size_t size,std::nothrow_t const& tag) noexcept
+{
+    return operator new(size,tag);
+}
+
+// every delete form goes through this one
+[[gnu::noinline]] void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p,std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p,std::nothrow_t const&) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p,std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p,std::nothrow_t const&) noexcept
+{
+    operator delete(p);
+}
+
+// void parallel_qs()
+// {
+//   std::list<int> a{5,7,9,12,2,10,1};
+//   auto res = parallel_quick_sort(a);
+//   std::for_each(res.begin(),res.end(), [](auto p){
+//     cout << p << endl;
+//   });
+// }
+
+void benchmark_sort()
+{
+  unsigned const size=1000000;
+  std::mt19937 gen(42);
+  std::list<int> input;
+  for(unsigned i=0;i<size;++i)
+    input.push_back(static_cast<int>(gen()));
+
+  std::clock_t const cpu_start=std::clock();
+  auto start=std::chrono::high_resolution_clock::now();
+  auto result=parallel_quick_sort(input);
+  auto stop=std::chrono::high_resolution_clock::now();
+  std::clock_t const cpu_stop=std::clock();
+
+  double const wall_seconds=
+    std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+  double const cpu_seconds=double(cpu_stop-cpu_start)/CLOCKS_PER_SEC;
+  // cpu/wall close to the thread count means busy threads; parked
+  // threads pull it down
+  std::cout<<"sorted "<<size<<" elements: wall "<<wall_seconds
+  <<" s, cpu "<<cpu_seconds<<" s, cpu/wall "<<cpu_seconds/wall_seconds
+  <<(std::is_sorted(result.begin(),result.end())?"":" (NOT SORTED)")
+  <<std::endl;
+}
+
+// once the descriptor pools have warmed up, a sort should not allocate
+void benchmark_sort_allocations()
+{
+  unsigned const size=1000000;
+  unsigned const calls=20;
+  std::mt19937 gen(42);
+  std::vector<int> input(size);
+  for(auto& x: input)
+    x=static_cast<int>(gen());
+  std::list<int> const list_input(input.begin(),input.end());
+
+  sorting_engine<int> engine;
+  std::vector<int> data(input);
+  std::list<int> list_data(list_input);
+  for(unsigned i=0;i<5;++i)
+  {
+    data=input;
+    engine.sort(data);
+    list_data=list_input;
+    engine.sort(list_data);
+  }
+
+  unsigned long vector_allocations=0;
+  unsigned long list_allocations=0;
+  for(unsigned i=0;i<calls;++i)
+  {
+    data=input;
+    unsigned long before=heap_allocations.load();
+    engine.sort(data);
+    vector_allocations+=heap_allocations.load()-before;
+
+    list_data=list_input;
+    before=heap_allocations.load();
+    engine.sort(list_data);
+    list_allocations+=heap_allocations.load()-before;
+  }
+  std::cout<<"heap allocations per sort of "<<size<<": vector "
+  <<double(vector_allocations)/calls<<", list "
+  <<double(list_allocations)/calls<<std::endl;
+}
+
+void benchmark_sort_engine()
+{
+  unsigned const batch_size=1000;
+  unsigned const batches=2000;
+  std::mt19937 gen(42);
+  std::vector<std::list<int> > inputs(batches);
+  for(auto& input: inputs)
+    for(unsigned i=0;i<batch_size;++i)
+      input.push_back(static_cast<int>(gen()));
+
+  auto start=std::chrono::high_resolution_clock::now();
+  for(auto const& input: inputs)
+    parallel_quick_sort(input);
+  auto stop=std::chrono::high_resolution_clock::now();
+  std::cout<<"sorter per call: "<<batches<<" batches of "<<batch_size<<" in "
+  <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+  <<" seconds"<<std::endl;
+
+  sorting_engine<int> engine;
+  start=std::chrono::high_resolution_clock::now();
+  for(auto const& input: inputs)
+  {
+    std::list<int> batch(input);
+    engine.sort(batch);
+  }
+  stop=std::chrono::high_resolution_clock::now();
+  std::cout<<"sorting_engine: "<<batches<<" batches of "<<batch_size<<" in "
+  <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+  <<" seconds"<<std::endl;
+  std::cout<<"latency us: p50 "<<engine.latency_percentile(0.5)
+  <<" p90 "<<engine.latency_percentile(0.9)
+  <<" p99 "<<engine.latency_percentile(0.99)
+  <<" p99.9 "<<engine.latency_percentile(0.999)
+  <<" max "<<engine.latency_percentile(1.0)<<std::endl;
+}
+
+// pass 1000000000 for the full sweep; the list sorts stop at list_limit
+void benchmark_vector_sort(std::size_t max_size)
+{
+  std::size_t const list_limit=10000000;
+  std::mt19937 gen(42);
+  for(std::size_t size=1000000;size<=max_size;size*=10)
+  {
+    std::vector<int> input(size);
+    for(auto& x: input)
+      x=static_cast<int>(gen());
+
+    std::vector<int> data(input);
+    auto start=std::chrono::high_resolution_clock::now();
+    std::sort(data.begin(),data.end());
+    auto stop=std::chrono::high_resolution_clock::now();
+    std::cout<<size<<" elements: std::sort "
+    <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()<<" s";
+
+    data=input;
+    start=std::chrono::high_resolution_clock::now();
+    parallel_quick_sort(data);
+    stop=std::chrono::high_resolution_clock::now();
+    std::cout<<", vector parallel_quick_sort "
+    <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()<<" s"
+    <<(std::is_sorted(data.begin(),data.end())?"":" (NOT SORTED)");
+
+    if(size<=list_limit)
+    {
+      std::list<int> list_input(input.begin(),input.end());
+      start=std::chrono::high_resolution_clock::now();
+      auto const result=parallel_quick_sort(list_input);
+      stop=std::chrono::high_resolution_clock::now();
+      std::cout<<", list parallel_quick_sort "
+      <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+      <<" s";
+    }
+    std::cout<<std::endl;
+  }
+}
+
+std::vector<int> adversarial_input(std::string const& pattern,
+                                   std::size_t size)
+{
+  std::vector<int> input(size);
+  for(std::size_t i=0;i<size;++i)
+  {
+    if(pattern=="sorted")
+      input[i]=static_cast<int>(i);
+    else if(pattern=="reversed")
+      input[i]=static_cast<int>(size-i);
+    else if(pattern=="organ-pipe")
+      input[i]=static_cast<int>(i<size/2?i:size-i);
+    else
+      input[i]=static_cast<int>(i%4);
+  }
+  return input;
+}
+
+void benchmark_adversarial_sort()
+{
+  std::size_t const size=1000000;
+  for(std::string const pattern:
+        {"sorted","reversed","organ-pipe","few-distinct"})
+  {
+    std::vector<int> const input=adversarial_input(pattern,size);
+    std::list<int> const list_input(input.begin(),input.end());
+
+    auto start=std::chrono::high_resolution_clock::now();
+    auto const result=parallel_quick_sort(list_input);
+    auto stop=std::chrono::high_resolution_clock::now();
+    std::cout<<pattern<<": list "
+    <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+    <<" s";
+
+    std::vector<int> data(input);
+    start=std::chrono::high_resolution_clock::now();
+    parallel_quick_sort(data);
+    stop=std::chrono::high_resolution_clock::now();
+    std::cout<<", vector "
+    <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+    <<" s"
+    <<(std::is_sorted(data.begin(),data.end()) &&
+       std::is_sorted(result.begin(),result.end())?"":" (NOT SORTED)")
+    <<std::endl;
+  }
+}
+
+void benchmark_duplicate_keys()
+{
+  std::size_t const size=1000000;
+  std::mt19937 gen(42);
+  for(unsigned const distinct: {2u,16u,256u})
+  {
+    std::vector<int> input(size);
+    for(auto& x: input)
+      x=static_cast<int>(gen()%distinct);
+    std::list<int> const list_input(input.begin(),input.end());
+
+    std::vector<int> data(input);
+    auto start=std::chrono::high_resolution_clock::now();
+    std::sort(data.begin(),data.end());
+    auto stop=std::chrono::high_resolution_clock::now();
+    std::cout<<distinct<<" distinct keys: std::sort "
+    <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+    <<" s";
+
+    data=input;
+    start=std::chrono::high_resolution_clock::now();
+    parallel_quick_sort(data);
+    stop=std::chrono::high_resolution_clock::now();
+    std::cout<<", vector "
+    <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+    <<" s";
+
+    start=std::chrono::high_resolution_clock::now();
+    auto const result=parallel_quick_sort(list_input);
+    stop=std::chrono::high_resolution_clock::now();
+    std::cout<<", list "
+    <<std::chrono::duration<double,std::ratio<1,1>>(stop-start).count()
+    <<" s"
+    <<(std::is_sorted(data.begin(),data.end()) &&
+       std::is_sorted(result.begin(),result.end())?"":" (NOT SORTED)")
+    <<std::endl;
+  }
+}
+
+struct record
+{
+  std::uint64_t id;
+  double score;
+  char payload[16];
+  bool operator<(record const& other) const
+  {
+    return score<other.score;
+  }
+};
+
+struct record_score
+{
+  double operator()(record const& r) const
+  {
+    return r.score;
+  }
+};
+
+template<typename Sort>
+double time_sort(Sort sort)
+{
+  auto const start=std::chrono::high_resolution_clock::now();
+  sort();
+  auto const stop=std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double,std::ratio<1,1>>(stop-start).count();
+}
+
+// leaf cost per element: many independent blocks of each size, sorted by
+// insertion sort and by the sorting network
+template<typename T>
+void benchmark_leaf_sort_for(char const* name)
+{
+  std::size_t const elements=1<<22;
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<int> dist(-1000000,1000000);
+  std::vector<T> input(elements);
+  for(auto& x: input)
+    x=static_cast<T>(dist(gen));
+  for(std::size_t n=4;n<=max_network_size;n+=4)
+  {
+    std::size_t const blocks=elements/n;
+    std::vector<T> data(input);
+    double const insertion=time_sort([&]{
+        for(std::size_t b=0;b<blocks;++b)
+          insertion_sort_range(data.data()+b*n,data.data()+(b+1)*n);
+      });
+    data=input;
+    double const network=time_sort([&]{
+        for(std::size_t b=0;b<blocks;++b)
+          small_sort_range(data.data()+b*n,data.data()+(b+1)*n);
+      });
+    bool sorted=true;
+    for(std::size_t b=0;b<blocks && sorted;++b)
+      sorted=std::is_sorted(data.data()+b*n,data.data()+(b+1)*n);
+    std::cout<<name<<" leaf of "<<n<<": insertion sort "
+    <<insertion*1e9/(blocks*n)<<" ns/element, network "
+    <<network*1e9/(blocks*n)<<" ns/element"
+    <<(sorted?"":" (NOT SORTED)")<<std::endl;
+  }
+}
+
+// -0.0 and +0.0 compare equal but are different values, so a sort must
+// hand back as many of each as it was given
+void check_signed_zeros()
+{
+  std::vector<double> input;
+  for(unsigned i=0;i<64;++i)
+    input.push_back(i%3==0?-0.0:i%3==1?0.0:static_cast<double>(i%4));
+  auto const same_values=[](auto const& sorted,auto first,auto last)
+  {
+    return std::is_sorted(sorted.begin(),sorted.end()) &&
+      std::is_permutation(sorted.begin(),sorted.end(),first,last,
+                          [](double x,double y)
+                          {return x==y && std::signbit(x)==std::signbit(y);});
+  };
+  bool ok=true;
+  for(std::size_t n=2;n<=max_network_size;++n)
+  {
+    std::vector<double> leaf(input.begin(),input.begin()+n);
+    small_sort_range(leaf.data(),leaf.data()+n);
+    ok=ok && same_values(leaf,input.begin(),input.begin()+n);
+  }
+  std::vector<double> data(input);
+  parallel_quick_sort(data);
+  ok=ok && same_values(data,input.begin(),input.end());
+  std::list<double> const list(input.begin(),input.end());
+  ok=ok && same_values(parallel_quick_sort(list),input.begin(),input.end());
+  std::cout<<"signed zeros and duplicates "
+  <<(ok?"preserved":"NOT PRESERVED")<<std::endl;
+}
+
+void benchmark_selection()
+{
+  std::size_t const size=10000000;
+  std::size_t const k=100;
+  std::mt19937 gen(42);
+  std::vector<int> input(size);
+  for(auto& x: input)
+    x=static_cast<int>(gen());
+
+  std::vector<int> data(input);
+  std::cout<<size<<" elements: parallel_quick_sort "
+  <<time_sort([&]{parallel_quick_sort(data);})<<" s";
+  int const median=data[size/2];
+  std::vector<int> const smallest(data.begin(),data.begin()+k);
+  std::vector<int> const largest(data.rbegin(),data.rbegin()+k);
+
+  data=input;
+  std::cout<<", std::nth_element "
+  <<time_sort([&]{std::nth_element(data.begin(),data.begin()+size/2,
+                                   data.end());})<<" s";
+  data=input;
+  std::cout<<", parallel_nth_element "
+  <<time_sort([&]{parallel_nth_element(data,size/2);})<<" s";
+  bool correct=data[size/2]==median;
+
+  data=input;
+  std::cout<<", std::partial_sort("<<k<<") "
+  <<time_sort([&]{std::partial_sort(data.begin(),data.begin()+k,
+                                    data.end());})<<" s";
+  data=input;
+  std::cout<<", parallel_partial_sort "
+  <<time_sort([&]{parallel_partial_sort(data,k);})<<" s";
+  correct=correct && std::equal(smallest.begin(),smallest.end(),data.begin());
+
+  std::vector<int> top;
+  std::cout<<", parallel_top_k "
+  <<time_sort([&]{top=parallel_top_k(input,k);})<<" s"
+  <<(correct && top==largest?"":" (WRONG RESULT)")<<std::endl;
+}
+
+// writes size random keys to a file, external-sorts it under budget
+// bytes of memory and checks the output by streaming it back
+void benchmark_external_sort(std::size_t size,std::size_t budget)
+{
+  std::filesystem::path const dir=std::filesystem::temp_directory_path();
+  std::filesystem::path const input=dir/"external_sort_input.bin";
+  std::filesystem::path const output=dir/"external_sort_output.bin";
+  {
+    file_ptr const f=open_file(input,"wb");
+    std::mt19937_64 gen(42);
+    std::vector<std::uint64_t> block(1<<16);
+    for(std::size_t written=0;written<size;written+=block.size())
+    {
+      for(auto& x: block)
+        x=gen();
+      write_records(f.get(),block.data(),
+                    std::min(block.size(),size-written));
+    }
+  }
+
+  external_sorter<std::uint64_t> sorter(budget,dir);
+  external_sort_stats const stats=sorter.sort_file(input,output);
+
+  bool sorted=std::filesystem::file_size(output)==stats.bytes;
+  {
+    file_ptr const f=open_file(output,"rb");
+    std::vector<std::uint64_t> block(1<<16);
+    std::uint64_t last=0;
+    while(std::size_t const got=read_records(f.get(),block.data(),
+                                             block.size()))
+    {
+      sorted=sorted && last<=block[0] &&
+        std::is_sorted(block.begin(),block.begin()+got);
+      last=block[got-1];
+    }
+  }
+  std::filesystem::remove(input);
+  std::filesystem::remove(output);
+
+  std::cout<<"external sort of "<<stats.bytes/1e6<<" MB in "
+  <<budget/1e6<<" MB: "<<stats.runs<<" runs, "<<stats.merge_passes
+  <<" merge passes, runs "<<stats.run_seconds<<" s, merge "
+  <<stats.merge_seconds<<" s, "<<stats.mb_per_second()<<" MB/s, peak buffers "
+  <<stats.peak_buffer_bytes/1e6<<" MB"<<(sorted?"":" (NOT SORTED)")
+  <<std::endl;
+}
+
+void benchmark_leaf_sort()
+{
+  benchmark_leaf_sort_for<int>("int");
+  benchmark_leaf_sort_for<float>("float");
+  benchmark_leaf_sort_for<double>("double");
+}
+
+void benchmark_radix_sort()
+{
+  std::size_t const size=4000000;
+  std::mt19937_64 gen(42);
+
+  std::vector<std::uint32_t> ints(size);
+  for(auto& x: ints)
+    x=static_cast<std::uint32_t>(gen());
+  std::list<std::uint32_t> const int_list(ints.begin(),ints.end());
+  std::vector<std::uint32_t> data(ints);
+  std::cout<<size<<" uint32: radix "
+  <<time_sort([&]{parallel_radix_sort(data);})<<" s";
+  bool sorted=std::is_sorted(data.begin(),data.end());
+  data=ints;
+  std::cout<<", vector quicksort "
+  <<time_sort([&]{parallel_quick_sort(data);})<<" s";
+  std::cout<<", list quicksort "
+  <<time_sort([&]{parallel_quick_sort(int_list);})<<" s"
+  <<(sorted?"":" (NOT SORTED)")<<std::endl;
+
+  std::uniform_real_distribution<float> real(-1e6f,1e6f);
+  std::vector<float> floats(size);
+  for(auto& x: floats)
+    x=real(gen);
+  std::vector<float> float_data(floats);
+  std::cout<<size<<" float: radix "
+  <<time_sort([&]{parallel_radix_sort(float_data);})<<" s";
+  sorted=std::is_sorted(float_data.begin(),float_data.end());
+  float_data=floats;
+  std::cout<<", vector quicksort "
+  <<time_sort([&]{parallel_quick_sort(float_data);})<<" s"
+  <<(sorted?"":" (NOT SORTED)")<<std::endl;
+
+  std::vector<record> records(size);
+  for(auto& r: records)
+  {
+    r.id=gen();
+    r.score=real(gen);
+  }
+  std::vector<record> record_data(records);
+  std::cout<<size<<" records by double key: radix "
+  <<time_sort([&]{parallel_radix_sort(record_data,record_score());})<<" s";
+  sorted=std::is_sorted(record_data.begin(),record_data.end());
+  record_data=records;
+  std::cout<<", vector quicksort "
+  <<time_sort([&]{parallel_quick_sort(record_data);})<<" s"
+  <<(sorted?"":" (NOT SORTED)")<<std::endl;
+}
+
+void benchmark_merge_sort()
+{
+  std::size_t const size=4000000;
+  std::mt19937_64 gen(42);
+  std::uniform_real_distribution<double> real(0,1000);
+  std::vector<record> records(size);
+  for(auto& r: records)
+  {
+    r.id=gen();
+    r.score=real(gen);
+  }
+
+  std::vector<record> data(records);
+  std::cout<<size<<" records: std::stable_sort "
+  <<time_sort([&]{std::stable_sort(data.begin(),data.end());})<<" s";
+  std::vector<record> const expected(data);
+
+  data=records;
+  std::cout<<", parallel_merge_sort "
+  <<time_sort([&]{parallel_merge_sort(data);})<<" s";
+  bool stable=std::equal(data.begin(),data.end(),expected.begin(),
+                         [](record const& a,record const& b){return a.id==b.id;});
+
+  std::vector<std::uint32_t> permutation;
+  std::cout<<", indices "
+  <<time_sort([&]{
+      permutation=parallel_merge_sort_indices(std::span<record const>(records));
+    })<<" s";
+  for(std::size_t i=0;i<size && stable;++i)
+    stable=records[permutation[i]].id==expected[i].id;
+
+  std::vector<std::pair<double,std::uint32_t> > pairs;
+  std::cout<<", (key,index) "
+  <<time_sort([&]{
+      pairs=parallel_merge_sort_key_index(std::span<record const>(records),
+                                          record_score());
+    })<<" s"<<std::endl;
+  for(std::size_t i=0;i<size && stable;++i)
+    stable=records[pairs[i].second].id==expected[i].id;
+  if(!stable)
+    std::cout<<"(ORDER DIFFERS FROM std::stable_sort)"<<std::endl;
+}
 
 int main()
 {
   // parallel_qs();
+  check_signed_zeros();
+  benchmark_sort();
+  benchmark_sort_engine();
+  benchmark_sort_allocations();
+  benchmark_vector_sort(10000000);
+  benchmark_adversarial_sort();
+  benchmark_duplicate_keys();
+  benchmark_radix_sort();
+  benchmark_merge_sort();
+  benchmark_leaf_sort();
+  benchmark_selection();
+  benchmark_external_sort(std::size_t(1)<<25,64<<20);
   return 0;
 }